@@ -0,0 +1,431 @@
+// Benchmarks for the httpcode library and binary. Results are written to
+// stdout as JSON so that runs can be compared across releases.
+//
+// Usage: httpcode_bench [--filter <substring>] [--min-time <seconds>]
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "batch.hpp"
+#include "code_set.hpp"
+#include "format.hpp"
+#include "httpcode/codes.hpp"
+#include "httpcode/status.h"
+#include "httpcode/status.hpp"
+#include "latency.hpp"
+#include "log_analysis.hpp"
+#include "registry.hpp"
+#include "rendered.hpp"
+#include "search.hpp"
+#include "stats.hpp"
+#include "switch_baseline.hpp"
+
+extern char** environ;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// Keeps the compiler from optimizing away a value that is otherwise unused.
+template <typename T>
+void do_not_optimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct result {
+  std::string name;
+  std::uint64_t iterations;
+  double seconds;
+  // Items processed per iteration, for throughput benchmarks.
+  std::uint64_t items_per_iteration = 1;
+  // Extra pre-formatted JSON members, e.g. latency percentiles.
+  std::string extra;
+};
+
+struct options {
+  std::string_view filter;
+  double min_time = 0.5;
+};
+
+// Runs `body` in batches of doubling size until at least `min_time` seconds
+// have been spent in the last batch.
+result run_micro(std::string_view name, double min_time,
+                 const std::function<void(std::uint64_t)>& body) {
+  std::uint64_t iterations = 1;
+  for (;;) {
+    const auto start = clock_type::now();
+    body(iterations);
+    const double seconds =
+        std::chrono::duration<double>(clock_type::now() - start).count();
+    if (seconds >= min_time || iterations >= (std::uint64_t{1} << 40)) {
+      return {std::string(name), iterations, seconds, 1, {}};
+    }
+    iterations *= seconds < min_time / 16 ? 8 : 2;
+  }
+}
+
+double ns_per_op(const result& r) {
+  return r.iterations == 0 ? 0
+                           : r.seconds * 1e9 / static_cast<double>(r.iterations);
+}
+
+// Times a loop with the stats calls of a hot path against the same loop
+// without them, alternating between the two and keeping the fastest run of
+// each, and reports the difference.
+result run_overhead(std::string_view name, double min_time,
+                    const std::function<void(std::uint64_t)>& instrumented,
+                    const std::function<void(std::uint64_t)>& bare) {
+  result best = run_micro(name, min_time, instrumented);
+  result best_bare = run_micro(name, min_time, bare);
+  for (int run = 0; run < 4; ++run) {
+    const result r = run_micro(name, min_time, instrumented);
+    if (ns_per_op(r) < ns_per_op(best)) best = r;
+    const result b = run_micro(name, min_time, bare);
+    if (ns_per_op(b) < ns_per_op(best_bare)) best_bare = b;
+  }
+  char extra[128];
+  std::snprintf(extra, sizeof(extra),
+                ", \"bare_ns_per_op\": %.3f, \"overhead_ns_per_op\": %.3f",
+                ns_per_op(best_bare), ns_per_op(best) - ns_per_op(best_bare));
+  best.extra = extra;
+  return best;
+}
+
+// Spawns `argv` with stdout redirected to /dev/null `runs` times and reports
+// exec-to-exit wall time percentiles.
+result run_cold_start(std::string_view name, double min_time,
+                      std::vector<const char*> argv) {
+  argv.push_back(nullptr);
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+
+  std::vector<double> micros;
+  const auto begin = clock_type::now();
+  while (std::chrono::duration<double>(clock_type::now() - begin).count() <
+             min_time * 4 ||
+         micros.size() < 100) {
+    const auto start = clock_type::now();
+    pid_t pid;
+    if (posix_spawn(&pid, argv[0], &actions, nullptr,
+                    const_cast<char* const*>(argv.data()), environ) != 0) {
+      break;
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    micros.push_back(
+        std::chrono::duration<double, std::micro>(clock_type::now() - start)
+            .count());
+  }
+  posix_spawn_file_actions_destroy(&actions);
+
+  result r{std::string(name), micros.size(), 0, 1, {}};
+  for (const double us : micros) r.seconds += us / 1e6;
+  if (!micros.empty()) {
+    std::sort(micros.begin(), micros.end());
+    char extra[128];
+    std::snprintf(extra, sizeof(extra),
+                  ", \"p50_us\": %.1f, \"p99_us\": %.1f, \"min_us\": %.1f",
+                  micros[micros.size() / 2],
+                  micros[static_cast<std::size_t>(0.99 * (micros.size() - 1))],
+                  micros.front());
+    r.extra = extra;
+  }
+  return r;
+}
+
+// Feeds `lines` newline-separated codes through `run_batch` from a memory file
+// to /dev/null.
+result run_batch_throughput(std::string_view name, double min_time,
+                            httpcode::output_format format) {
+  constexpr std::uint64_t lines = 1'000'000;
+  constexpr unsigned int mix[] = {200, 404, 500, 301, 302,
+                                  304, 429, 502, 503, 201};
+  std::string input;
+  for (std::uint64_t i = 0; i < lines; ++i) {
+    input += std::to_string(mix[i % std::size(mix)]);
+    input += '\n';
+  }
+  const int in_fd = memfd_create("httpcode_bench", 0);
+  const int out_fd = open("/dev/null", O_WRONLY);
+  if (in_fd < 0 || out_fd < 0 ||
+      write(in_fd, input.data(), input.size()) !=
+          static_cast<ssize_t>(input.size())) {
+    return {std::string(name), 0, 0, 1, {}};
+  }
+
+  result r = run_micro(name, min_time, [&](std::uint64_t n) {
+    for (std::uint64_t i = 0; i < n; ++i) {
+      lseek(in_fd, 0, SEEK_SET);
+      httpcode::run_batch(in_fd, out_fd, httpcode::registry(), format);
+    }
+  });
+  r.items_per_iteration = lines;
+  close(in_fd);
+  close(out_fd);
+  return r;
+}
+
+// Compiles a registry that overrides every code in [100, 599] into a memory
+// file and returns a path to it that child processes can open as well.
+std::string make_full_registry() {
+  std::string source;
+  for (unsigned int code = httpcode::min_code; code <= httpcode::max_code;
+       ++code) {
+    const std::string n = std::to_string(code);
+    source += "[" + n + "]\nshort = \"Vendor status " + n +
+              "\"\nlong = \"Description of vendor status " + n +
+              ".\"\nurl = \"https://example.com/status/" + n + "\"\n";
+  }
+  const auto image = httpcode::compile_registry(source);
+  const int fd = memfd_create("httpcode_registry", 0);
+  if (!image.has_value() || fd < 0 ||
+      write(fd, image->data(), image->size()) !=
+          static_cast<ssize_t>(image->size())) {
+    return {};
+  }
+  return "/proc/self/fd/" + std::to_string(fd);
+}
+
+void print_json(const std::vector<result>& results) {
+  // Runs with and without HTTPCODE_STATS are compared to check that the
+  // instrumentation costs nothing when it is compiled out.
+  std::printf("{\n  \"stats_compiled_in\": %s,\n  \"benchmarks\": [",
+              httpcode::stats::compiled_in ? "true" : "false");
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const result& r = results[i];
+    const double items_per_second =
+        r.seconds == 0 ? 0
+                       : static_cast<double>(r.iterations) *
+                             static_cast<double>(r.items_per_iteration) /
+                             r.seconds;
+    std::printf(
+        "%s\n    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": "
+        "%.3f, \"items_per_second\": %.1f%s}",
+        i == 0 ? "" : ",", r.name.c_str(),
+        static_cast<unsigned long long>(r.iterations), ns_per_op(r),
+        items_per_second, r.extra.c_str());
+  }
+  std::printf("\n  ]\n}\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    bool valid = true;
+    if (arg == "--filter" && i + 1 < argc) {
+      opts.filter = argv[++i];
+    } else if (arg == "--min-time" && i + 1 < argc) {
+      // The whole value must be a positive, finite number of seconds.
+      const std::string_view value = argv[++i];
+      const auto [end, ec] = std::from_chars(
+          value.data(), value.data() + value.size(), opts.min_time);
+      valid = ec == std::errc() && end == value.data() + value.size() &&
+              opts.min_time > 0 && std::isfinite(opts.min_time);
+    } else {
+      valid = false;
+    }
+    if (!valid) {
+      std::fprintf(stderr,
+                   "Usage: httpcode_bench [--filter <substring>] "
+                   "[--min-time <seconds>]\n");
+      return 1;
+    }
+  }
+
+  // Inputs are read through a volatile so that lookups cannot be folded at
+  // compile time.
+  static volatile long hit_code = 404;
+  static volatile long miss_code = 306;
+  static const char* volatile valid_digits = "503";
+  static const char* volatile invalid_digits = "list";
+  static const char* volatile code_query = "500-511,429,4xx,-404";
+  static const char* volatile search_term = "timeout";
+  static const char* volatile search_terms = "gateway timeout";
+  static const char* volatile log_line =
+      "10.0.0.1 - - [10/Oct/2000:13:55:36 -0700] \"GET /a.gif HTTP/1.1\" 504 "
+      "2326 \"-\" \"Mozilla/5.0 (X11; Linux x86_64)\" 30.004\n";
+
+  // A fixed pseudo-random mix of known codes, so that the switch baseline
+  // cannot win on branch prediction alone.
+  std::array<unsigned int, 1024> mixed_codes;
+  std::uint32_t state = 0x9e3779b9;
+  for (unsigned int& code : mixed_codes) {
+    state = state * 1664525 + 1013904223;
+    code = httpcode::code_entries[(state >> 8) %
+                                  std::size(httpcode::code_entries)]
+               .first;
+  }
+  std::size_t next_code = 0;
+  const auto mixed_code = [&] { return mixed_codes[next_code++ & 1023]; };
+
+  std::vector<result> results;
+  const auto micro = [&](std::string_view name, auto&& fn) {
+    if (name.find(opts.filter) == std::string_view::npos) return;
+    results.push_back(run_micro(name, opts.min_time, [&](std::uint64_t n) {
+      for (std::uint64_t i = 0; i < n; ++i) fn();
+    }));
+  };
+
+  micro("lookup/hit", [] { do_not_optimize(httpcode::find_code(hit_code)); });
+  micro("lookup/miss", [] { do_not_optimize(httpcode::find_code(miss_code)); });
+  micro("rendered_code/hit",
+        [] { do_not_optimize(httpcode::rendered_code(hit_code)); });
+  micro("to_digit/valid",
+        [] { do_not_optimize(httpcode::to_digit(valid_digits)); });
+  micro("to_digit/invalid",
+        [] { do_not_optimize(httpcode::to_digit(invalid_digits)); });
+  micro("format_output", [] {
+    const auto desc = *httpcode::find_code(hit_code);
+    const auto& [short_desc, long_desc, url] = desc;
+    do_not_optimize(httpcode::format_output(static_cast<unsigned int>(hit_code),
+                                            short_desc, long_desc, url));
+  });
+  micro("status_line/table",
+        [&] { do_not_optimize(httpcode::status_line(mixed_code())); });
+  micro("status_line/switch",
+        [&] { do_not_optimize(switch_status_line(mixed_code())); });
+  micro("status_line/c_api", [&] {
+    std::size_t length;
+    do_not_optimize(httpcode_status_line(mixed_code(), &length));
+    do_not_optimize(length);
+  });
+  micro("reason_phrase/table",
+        [&] { do_not_optimize(httpcode::reason_phrase(mixed_code())); });
+  micro("list_all_codes",
+        [] { do_not_optimize(httpcode::list_all_codes()); });
+  micro("list_all_codes_for_category", [] {
+    do_not_optimize(httpcode::list_all_codes_for_category("server-error"));
+  });
+  const httpcode::code_set only = *httpcode::parse_code_query("5xx,429");
+  micro("code_set/contains",
+        [&] { do_not_optimize(only.contains(mixed_code())); });
+  micro("code_query/parse",
+        [] { do_not_optimize(httpcode::parse_code_query(code_query)); });
+  micro("search/one_term", [] {
+    const std::string_view query[] = {search_term};
+    httpcode::search_results hits;
+    do_not_optimize(httpcode::search(query, hits));
+    do_not_optimize(hits);
+  });
+  micro("search/two_terms", [] {
+    const std::string_view query[] = {search_terms};
+    httpcode::search_results hits;
+    do_not_optimize(httpcode::search(query, hits));
+    do_not_optimize(hits);
+  });
+  httpcode::latency_histogram histogram;
+  micro("latency/record", [&] { histogram.record(mixed_code() * 997); });
+  do_not_optimize(histogram.count());
+  httpcode::log_analysis line_analysis;
+  httpcode::analysis_options latency_options;
+  latency_options.latency_field = -1;
+  micro("latency/scan_line",
+        [&] { line_analysis.scan(log_line, latency_options); });
+  httpcode::analysis_options top_options;
+  top_options.top_by = httpcode::top_key::path;
+  micro("top_keys/scan_line",
+        [&] { line_analysis.scan(log_line, top_options); });
+  do_not_optimize(line_analysis.counts);
+
+  // Without HTTPCODE_STATS, a timer is an empty object and these measure the
+  // loop alone. With it, they measure the test of the runtime flag.
+  static_assert(httpcode::stats::compiled_in ||
+                std::is_empty_v<httpcode::stats::scoped_timer>);
+  micro("stats/add",
+        [] { httpcode::stats::add(httpcode::stats::counter::lines); });
+  micro("stats/scoped_timer", [] {
+    const httpcode::stats::scoped_timer timer(httpcode::stats::stage::parse);
+    do_not_optimize(&timer);
+  });
+
+  // The per-line stats calls of the scan and lookup paths, against the same
+  // work without them. Without HTTPCODE_STATS both must run equally fast.
+  const auto overhead = [&](std::string_view name, auto&& instrumented,
+                            auto&& bare) {
+    if (name.find(opts.filter) == std::string_view::npos) return;
+    results.push_back(run_overhead(
+        name, opts.min_time,
+        [&](std::uint64_t n) {
+          for (std::uint64_t i = 0; i < n; ++i) instrumented();
+        },
+        [&](std::uint64_t n) {
+          for (std::uint64_t i = 0; i < n; ++i) bare();
+        }));
+  };
+  overhead(
+      "stats/overhead/scan_line",
+      [] {
+        const httpcode::stats::scoped_timer timer(httpcode::stats::stage::scan);
+        httpcode::stats::add(httpcode::stats::counter::lines);
+        do_not_optimize(httpcode::find_status(log_line));
+      },
+      [] { do_not_optimize(httpcode::find_status(log_line)); });
+  overhead(
+      "stats/overhead/lookup",
+      [] {
+        const httpcode::stats::scoped_timer timer(
+            httpcode::stats::stage::lookup);
+        httpcode::stats::add(httpcode::stats::counter::lines);
+        do_not_optimize(httpcode::find_code(hit_code));
+      },
+      [] { do_not_optimize(httpcode::find_code(hit_code)); });
+
+  const std::string registry_path = make_full_registry();
+  micro("registry/open_and_find", [&] {
+    const auto names = httpcode::registry::open(registry_path.c_str());
+    do_not_optimize(names->find(hit_code));
+  });
+
+  if (std::string_view("batch/throughput").find(opts.filter) !=
+      std::string_view::npos) {
+    results.push_back(run_batch_throughput("batch/throughput", opts.min_time,
+                                           httpcode::output_format::text));
+  }
+  if (std::string_view("batch/throughput_ndjson").find(opts.filter) !=
+      std::string_view::npos) {
+    results.push_back(run_batch_throughput("batch/throughput_ndjson",
+                                           opts.min_time,
+                                           httpcode::output_format::ndjson));
+  }
+  if (std::string_view("cold_start/lookup").find(opts.filter) !=
+      std::string_view::npos) {
+    results.push_back(run_cold_start("cold_start/lookup", opts.min_time,
+                                     {HTTPCODE_BINARY, "404"}));
+  }
+  if (std::string_view("cold_start/lookup_registry").find(opts.filter) !=
+      std::string_view::npos) {
+    results.push_back(
+        run_cold_start("cold_start/lookup_registry", opts.min_time,
+                       {HTTPCODE_BINARY, "--registry", registry_path.c_str(),
+                        "404"}));
+  }
+  if (std::string_view("cold_start/list").find(opts.filter) !=
+      std::string_view::npos) {
+    results.push_back(run_cold_start("cold_start/list", opts.min_time,
+                                     {HTTPCODE_BINARY, "list"}));
+  }
+
+  print_json(results);
+  return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef HTTPCODE_STATUS_H_
+#define HTTPCODE_STATUS_H_
+
+/* C interface to the HTTP status code table. All returned strings are static,
+ * NUL-terminated and must not be freed. No function allocates. */
+
+#include <stddef.h>
+
+#if defined(__GNUC__)
+#define HTTPCODE_C_API __attribute__((visibility("default")))
+#else
+#define HTTPCODE_C_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Status classes returned by httpcode_status_class(). */
+enum {
+  HTTPCODE_UNKNOWN = 0,
+  HTTPCODE_INFORMATIONAL = 1,
+  HTTPCODE_SUCCESS = 2,
+  HTTPCODE_REDIRECTION = 3,
+  HTTPCODE_CLIENT_ERROR = 4,
+  HTTPCODE_SERVER_ERROR = 5
+};
+
+/* Returns the class of any code in [100, 599] by its first digit, or
+ * HTTPCODE_UNKNOWN. */
+HTTPCODE_C_API int httpcode_status_class(unsigned int code);
+
+/* Returns 1 if `code` is in the status code table, 0 otherwise. */
+HTTPCODE_C_API int httpcode_is_known(unsigned int code);
+
+/* Returns the reason phrase of `code` (e.g. "Not Found"), or NULL if the code
+ * is unknown. If `length` is not NULL, the length of the phrase is stored in
+ * it. */
+HTTPCODE_C_API const char* httpcode_reason_phrase(unsigned int code,
+                                                  size_t* length);
+
+/* Returns the HTTP/1.1 status line of `code` including its CRLF (e.g.
+ * "HTTP/1.1 404 Not Found\r\n"), or NULL if the code is unknown. If `length`
+ * is not NULL, the length of the line is stored in it. */
+HTTPCODE_C_API const char* httpcode_status_line(unsigned int code,
+                                                size_t* length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTTPCODE_STATUS_H_ */
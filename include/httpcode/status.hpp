@@ -0,0 +1,162 @@
+#ifndef HTTPCODE_STATUS_HPP_
+#define HTTPCODE_STATUS_HPP_
+
+// Allocation-free, exception-free access to HTTP status codes for use in
+// response-writing paths. Everything here is constexpr and backed by static
+// tables built at compile time from `codes`.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "httpcode/codes.hpp"
+
+namespace httpcode {
+
+// Class of a status code, as given by its first digit.
+enum class status_class : std::uint8_t {
+  unknown = 0,
+  informational = 1,
+  success = 2,
+  redirection = 3,
+  client_error = 4,
+  server_error = 5,
+};
+
+// Classifies any code in [100, 599] by its first digit, whether or not the
+// code itself is in the table.
+constexpr status_class classify(unsigned int code) noexcept {
+  if (code < min_code || code > max_code) {
+    return status_class::unknown;
+  }
+  return static_cast<status_class>(code / 100);
+}
+
+// Returns whether `code` is in the status code table.
+constexpr bool is_known(unsigned int code) noexcept {
+  return find_code(code).has_value();
+}
+
+namespace detail {
+
+inline constexpr std::string_view status_line_prefix = "HTTP/1.1 ";
+
+struct status_span {
+  std::uint16_t offset = 0;
+  std::uint16_t size = 0;
+};
+
+// Location of the NUL-terminated reason phrase and status line of each code in
+// `status_blob`.
+struct status_strings {
+  std::array<status_span, max_code - min_code + 1> reasons{};
+  std::array<status_span, max_code - min_code + 1> lines{};
+};
+
+// Writes every reason phrase and status line to `out` (or only measures them
+// while `out` is null), records where each one starts in `index`, and returns
+// the total size.
+constexpr std::size_t render_status_strings(char* out,
+                                            status_strings& index) noexcept {
+  std::size_t size = 0;
+  const auto put = [&](std::string_view s) {
+    for (const char c : s) {
+      if (out != nullptr) out[size] = c;
+      ++size;
+    }
+  };
+  const auto mark = [&](status_span& span, std::size_t start) {
+    span = {static_cast<std::uint16_t>(start),
+            static_cast<std::uint16_t>(size - start)};
+  };
+
+  for (const auto& [code, desc] : code_entries) {
+    const std::string_view reason = std::get<0>(desc);
+    std::size_t start = size;
+    put(reason);
+    mark(index.reasons[code - min_code], start);
+    put(std::string_view("", 1));
+
+    const char digits[] = {static_cast<char>('0' + code / 100),
+                           static_cast<char>('0' + code / 10 % 10),
+                           static_cast<char>('0' + code % 10), ' '};
+    start = size;
+    put(status_line_prefix);
+    put(std::string_view(digits, 4));
+    put(reason);
+    put("\r\n");
+    mark(index.lines[code - min_code], start);
+    put(std::string_view("", 1));
+  }
+  return size;
+}
+
+inline constexpr status_strings status_index = [] {
+  status_strings index;
+  render_status_strings(nullptr, index);
+  return index;
+}();
+
+inline constexpr std::size_t status_blob_size = [] {
+  status_strings index;
+  return render_status_strings(nullptr, index);
+}();
+
+inline constexpr std::array<char, status_blob_size> status_blob = [] {
+  std::array<char, status_blob_size> blob{};
+  status_strings index;
+  render_status_strings(blob.data(), index);
+  return blob;
+}();
+
+constexpr std::string_view status_view(
+    const std::array<status_span, max_code - min_code + 1>& spans,
+    unsigned int code) noexcept {
+  if (code < min_code || code > max_code) {
+    return {};
+  }
+  const status_span span = spans[code - min_code];
+  return std::string_view(status_blob.data() + span.offset, span.size);
+}
+
+}  // namespace detail
+
+// Returns the reason phrase of `code` (e.g. "Not Found"), or an empty view if
+// the code is unknown. The view is followed by a NUL terminator.
+constexpr std::string_view reason_phrase(unsigned int code) noexcept {
+  return detail::status_view(detail::status_index.reasons, code);
+}
+
+// Returns the complete HTTP/1.1 status line of `code`, CRLF included (e.g.
+// "HTTP/1.1 404 Not Found\r\n"), or an empty view if the code is unknown. The
+// view is followed by a NUL terminator.
+constexpr std::string_view status_line(unsigned int code) noexcept {
+  return detail::status_view(detail::status_index.lines, code);
+}
+
+static_assert(classify(404) == status_class::client_error);
+static_assert(classify(306) == status_class::redirection);
+static_assert(classify(600) == status_class::unknown);
+static_assert(classify(99) == status_class::unknown);
+static_assert(reason_phrase(404) == "Not Found");
+static_assert(reason_phrase(306).empty());
+static_assert(reason_phrase(1000).empty());
+static_assert(status_line(200) == "HTTP/1.1 200 OK\r\n");
+static_assert(status_line(404) == "HTTP/1.1 404 Not Found\r\n");
+static_assert(status_line(404).data()[status_line(404).size()] == '\0');
+static_assert([] {
+  for (const auto& [code, desc] : code_entries) {
+    const std::string_view reason = reason_phrase(code);
+    if (reason != std::get<0>(desc) ||
+        reason.find_first_of("\r\n") != std::string_view::npos ||
+        status_line(code).size() != 15 + reason.size()) {
+      return false;
+    }
+  }
+  return true;
+}());
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_STATUS_HPP_
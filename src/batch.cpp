@@ -0,0 +1,140 @@
+#include "batch.hpp"
+
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+#include "format.hpp"
+#include "httpcode/codes.hpp"
+#include "output_buffer.hpp"
+#include "registry.hpp"
+#include "stats.hpp"
+
+namespace httpcode {
+
+namespace {
+
+// Longest part of an invalid input line that is repeated in its record.
+constexpr std::size_t max_echoed_input = 256;
+
+// Writes the answer for a single line of batch input, as text or, if `writer`
+// is set, as a record. Blank lines are skipped and anything that is not a
+// known status code is reported inline.
+void append_batch_line(output_buffer& out, record_writer* writer,
+                       const registry& names, std::string_view line,
+                       bool& first) noexcept {
+  while (!line.empty() && (line.back() == '\r' || line.back() == ' ' ||
+                           line.back() == '\t')) {
+    line.remove_suffix(1);
+  }
+  while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) {
+    line.remove_prefix(1);
+  }
+  if (line.empty()) {
+    return;
+  }
+  stats::add(stats::counter::lines);
+  if (!first && writer == nullptr) {
+    out.append('\n');
+  }
+  first = false;
+
+  const auto code = to_digit(line);
+  const auto desc = code.has_value() &&
+                            line.find_first_not_of("0123456789") ==
+                                std::string_view::npos
+                        ? names.find(*code)
+                        : std::nullopt;
+  if (writer != nullptr && desc.has_value()) {
+    writer->status(static_cast<unsigned int>(*code), *desc);
+  } else if (writer != nullptr) {
+    writer->invalid(line.substr(0, max_echoed_input));
+  } else if (desc.has_value()) {
+    append_output(out, *code, *desc);
+  } else {
+    out.append("Error: Invalid HTTP status code '");
+    out.append(line);
+    out.append("'.\n");
+  }
+}
+
+}  // namespace
+
+bool run_batch(int in_fd, int out_fd, const registry& names,
+               output_format format) noexcept {
+  static std::array<char, 1 << 20> input;
+  output_buffer out(out_fd);
+  std::optional<record_writer> records;
+  if (format != output_format::text) {
+    records.emplace(out, format, record_kind::status);
+  }
+  record_writer* const writer = records.has_value() ? &*records : nullptr;
+  bool first = true;
+  bool discarding = false;
+  std::size_t pending = 0;
+
+  for (;;) {
+    ssize_t n;
+    {
+      const stats::scoped_timer timer(stats::stage::read);
+      n = ::read(in_fd, input.data() + pending, input.size() - pending);
+      stats::add(stats::counter::read_calls);
+    }
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    stats::add(stats::counter::bytes_read, static_cast<std::size_t>(n));
+
+    const char* const data = input.data();
+    const std::size_t size = pending + static_cast<std::size_t>(n);
+    std::size_t start = 0;
+    while (const void* nl = std::memchr(data + start, '\n', size - start)) {
+      const std::size_t end = static_cast<const char*>(nl) - data;
+      if (discarding) {
+        discarding = false;
+      } else {
+        append_batch_line(out, writer, names,
+                          std::string_view(data + start, end - start), first);
+      }
+      start = end + 1;
+    }
+
+    if (n == 0) {
+      if (start < size && !discarding) {
+        append_batch_line(out, writer, names,
+                          std::string_view(data + start, size - start), first);
+      }
+      break;
+    }
+
+    pending = size - start;
+    if (pending == input.size()) {
+      if (writer != nullptr) {
+        writer->invalid(std::string_view(data + start, max_echoed_input));
+      } else {
+        if (!first) {
+          out.append('\n');
+        }
+        out.append(invalid_code);
+      }
+      first = false;
+      discarding = true;
+      pending = 0;
+    } else {
+      std::memmove(input.data(), data + start, pending);
+    }
+  }
+
+  if (writer != nullptr) {
+    writer->finish();
+  }
+  return out.flush();
+}
+
+}  // namespace httpcode
@@ -0,0 +1,20 @@
+#ifndef HTTPCODE_BATCH_HPP_
+#define HTTPCODE_BATCH_HPP_
+
+#include "registry.hpp"
+#include "serialize.hpp"
+
+namespace httpcode {
+
+// Reads newline-separated status codes from `in_fd` in large blocks and writes
+// the description of each one to `out_fd`, separated by blank lines. Blank
+// input lines are skipped and anything that is not in `names` is reported
+// inline. Lines longer than the input buffer are reported as invalid and
+// discarded. With any other `format` than text, every non-blank line becomes
+// one status record instead. Returns false if reading or writing failed.
+bool run_batch(int in_fd, int out_fd, const registry& names,
+               output_format format = output_format::text) noexcept;
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_BATCH_HPP_
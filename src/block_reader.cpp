@@ -0,0 +1,465 @@
+#include "block_reader.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "io_ring.hpp"
+#include "mapped_file.hpp"
+#include "stats.hpp"
+
+namespace httpcode {
+
+namespace {
+
+constexpr std::size_t alignment = 4096;
+
+std::runtime_error read_error(const char* path, std::error_code error) {
+  std::string what = "Cannot read '";
+  what += path;
+  what += "': ";
+  what += error.message();
+  return std::runtime_error(what);
+}
+
+std::error_code errno_code(int err) noexcept {
+  return std::error_code(err, std::generic_category());
+}
+
+struct free_deleter {
+  void operator()(char* p) const noexcept { std::free(p); }
+};
+
+// Queue between the reader and the workers, unbounded because the number of
+// buffers bounds what can be in it.
+template <typename T>
+class blocking_queue {
+ public:
+  void push(T item) {
+    {
+      const std::lock_guard lock(mutex_);
+      items_.push_back(std::move(item));
+    }
+    ready_.notify_one();
+  }
+
+  // Returns the next item, or nothing once the queue is closed and empty.
+  std::optional<T> pop() {
+    std::unique_lock lock(mutex_);
+    ready_.wait(lock, [&] { return !items_.empty() || closed_; });
+    return take();
+  }
+
+  std::optional<T> try_pop() {
+    const std::lock_guard lock(mutex_);
+    return take();
+  }
+
+  void close() {
+    {
+      const std::lock_guard lock(mutex_);
+      closed_ = true;
+    }
+    ready_.notify_all();
+  }
+
+ private:
+  std::optional<T> take() {
+    if (items_.empty()) {
+      return std::nullopt;
+    }
+    T item = std::move(items_.front());
+    items_.pop_front();
+    return item;
+  }
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<T> items_;
+  bool closed_ = false;
+};
+
+// A read into one buffer. `size` is the part of the file it covers, which
+// O_DIRECT reads round up to the alignment.
+struct block {
+  std::uint32_t file;
+  std::uint32_t size;
+  std::uint32_t filled;
+  std::uint64_t offset;
+};
+
+struct piece {
+  unsigned int buffer;
+  std::string_view lines;
+};
+
+struct log_file {
+  const char* path;
+  int fd = -1;
+  bool direct = false;
+  std::uint64_t size = 0;
+  // Offset of the next read, and of the next block to pass on.
+  std::uint64_t submitted = 0;
+  std::uint64_t dispatched = 0;
+  // The unterminated line at the end of the blocks passed on so far.
+  std::string carry;
+  // Completed blocks that wait for an earlier one, by offset.
+  std::map<std::uint64_t, unsigned int> done;
+};
+
+class block_pipeline {
+ public:
+  block_pipeline(std::span<const char* const> paths,
+                 const block_read_options& options,
+                 const std::function<void(unsigned int, std::string_view)>& fn)
+      : options_(options), fn_(fn) {
+    options_.threads = std::max(options_.threads, 1u);
+    options_.queue_depth = std::max(options_.queue_depth, 1u);
+    options_.block_size =
+        std::max(options_.block_size / alignment, std::size_t{1}) * alignment;
+    files_.reserve(paths.size());
+    for (const char* path : paths) {
+      files_.emplace_back().path = path;
+    }
+  }
+
+  block_pipeline(const block_pipeline&) = delete;
+  block_pipeline& operator=(const block_pipeline&) = delete;
+
+  ~block_pipeline() {
+    for (const log_file& f : files_) {
+      if (f.fd >= 0) {
+        ::close(f.fd);
+      }
+    }
+  }
+
+  tl::expected<void, std::runtime_error> run();
+
+ private:
+  char* buffer(unsigned int b) const noexcept {
+    return memory_.get() + std::size_t{b} * options_.block_size;
+  }
+
+  void setup_ring(unsigned int buffers);
+  tl::expected<bool, std::runtime_error> next_read();
+  void issue(unsigned int b);
+  void submit_read(unsigned int b);
+  std::error_code reap();
+  void complete(unsigned int b, int result);
+  void advance();
+  void dispatch(log_file& f, unsigned int b);
+
+  block_read_options options_;
+  const std::function<void(unsigned int, std::string_view)>& fn_;
+  std::vector<log_file> files_;
+  // Files up to `opened_` have been opened, those before `next_file_` fully
+  // requested and those before `dispatch_file_` fully passed on.
+  std::size_t opened_ = 0;
+  std::size_t next_file_ = 0;
+  std::size_t dispatch_file_ = 0;
+
+  std::unique_ptr<char, free_deleter> memory_;
+  std::vector<block> blocks_;
+  std::optional<io_ring> ring_;
+  bool fixed_ = false;
+  // Completions of `pread`, which finishes before `submit_read` returns.
+  std::vector<std::pair<unsigned int, int>> completed_;
+  unsigned int inflight_ = 0;
+  std::optional<std::runtime_error> error_;
+
+  blocking_queue<unsigned int> free_;
+  blocking_queue<piece> full_;
+};
+
+tl::expected<void, std::runtime_error> block_pipeline::run() {
+  // Enough buffers to keep the queue full while every worker scans one and
+  // has another waiting.
+  const unsigned int buffers = options_.queue_depth + 2 * options_.threads;
+  memory_.reset(static_cast<char*>(
+      std::aligned_alloc(alignment, buffers * options_.block_size)));
+  if (memory_ == nullptr) {
+    throw std::bad_alloc();
+  }
+  blocks_.resize(buffers);
+  if (options_.backend == io_backend::uring) {
+    setup_ring(buffers);
+  }
+  for (unsigned int b = 0; b < buffers; ++b) {
+    free_.push(b);
+  }
+
+  std::vector<std::thread> workers;
+  workers.reserve(options_.threads);
+  for (unsigned int w = 0; w < options_.threads; ++w) {
+    workers.emplace_back([this, w] {
+      for (auto p = full_.pop(); p.has_value(); p = full_.pop()) {
+        fn_(w, p->lines);
+        free_.push(p->buffer);
+      }
+    });
+  }
+
+  while (!error_.has_value()) {
+    advance();
+    while (inflight_ < options_.queue_depth) {
+      const auto more = next_read();
+      if (!more.has_value()) {
+        error_ = more.error();
+        break;
+      }
+      if (!*more) {
+        break;
+      }
+      // With nothing in flight, wait for the workers to hand a buffer back.
+      const auto b = inflight_ == 0 ? free_.pop() : free_.try_pop();
+      if (!b.has_value()) {
+        break;
+      }
+      issue(*b);
+    }
+    if (inflight_ == 0) {
+      advance();
+      break;
+    }
+    if (const std::error_code ec = reap()) {
+      error_ = std::runtime_error("Cannot read logs: " + ec.message());
+      break;
+    }
+  }
+
+  // Reads still in flight write into the buffers, which must outlive them.
+  while (inflight_ != 0 && !reap()) {
+  }
+  full_.close();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  if (error_.has_value()) {
+    return tl::make_unexpected(*error_);
+  }
+  return {};
+}
+
+void block_pipeline::setup_ring(unsigned int buffers) {
+  auto ring = io_ring::create(options_.queue_depth);
+  if (!ring.has_value()) {
+    return;
+  }
+  std::vector<iovec> iovecs(buffers);
+  for (unsigned int b = 0; b < buffers; ++b) {
+    iovecs[b] = {buffer(b), options_.block_size};
+  }
+  fixed_ = !ring->register_buffers(iovecs);
+  ring_.emplace(std::move(*ring));
+}
+
+// Opens files until one has data left to request. Returns false once every
+// file has been requested.
+tl::expected<bool, std::runtime_error> block_pipeline::next_read() {
+  for (; next_file_ < files_.size(); ++next_file_) {
+    log_file& f = files_[next_file_];
+    if (opened_ == next_file_) {
+      const stats::scoped_timer timer(stats::stage::map);
+      f.fd = ::open(f.path, O_RDONLY | O_CLOEXEC | (options_.direct ? O_DIRECT
+                                                                    : 0));
+      f.direct = options_.direct;
+      // Some file systems do not support O_DIRECT.
+      if (f.fd < 0 && options_.direct && errno == EINVAL) {
+        f.fd = ::open(f.path, O_RDONLY | O_CLOEXEC);
+        f.direct = false;
+      }
+      struct stat st;
+      if (f.fd < 0 || ::fstat(f.fd, &st) != 0) {
+        return tl::make_unexpected(read_error(f.path, errno_code(errno)));
+      }
+      // Reads are sized by the file, which a pipe does not have.
+      if (!S_ISREG(st.st_mode)) {
+        return tl::make_unexpected(read_error(f.path, not_regular_file()));
+      }
+      f.size = static_cast<std::uint64_t>(st.st_size);
+      ++opened_;
+      if (!f.direct) {
+        ::posix_fadvise(f.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      }
+    }
+    if (f.submitted < f.size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void block_pipeline::issue(unsigned int b) {
+  log_file& f = files_[next_file_];
+  const std::uint64_t size =
+      std::min<std::uint64_t>(options_.block_size, f.size - f.submitted);
+  blocks_[b] = {.file = static_cast<std::uint32_t>(next_file_),
+                .size = static_cast<std::uint32_t>(size),
+                .filled = 0,
+                .offset = f.submitted};
+  f.submitted += size;
+  submit_read(b);
+}
+
+void block_pipeline::submit_read(unsigned int b) {
+  const block& k = blocks_[b];
+  const log_file& f = files_[k.file];
+  const std::size_t length =
+      f.direct ? (k.size + alignment - 1) / alignment * alignment : k.size;
+  char* data = buffer(b) + k.filled;
+  const std::uint64_t offset = k.offset + k.filled;
+  ++inflight_;
+
+  if (ring_.has_value()) {
+    // Never full: the ring has a slot for every read that can be in flight.
+    ring_->read(f.fd, data, static_cast<std::uint32_t>(length - k.filled),
+                offset, fixed_ ? std::optional(b) : std::nullopt, b);
+    return;
+  }
+  ssize_t n;
+  {
+    const stats::scoped_timer timer(stats::stage::read);
+    do {
+      n = ::pread(f.fd, data, length - k.filled, static_cast<off_t>(offset));
+    } while (n < 0 && errno == EINTR);
+  }
+  stats::add(stats::counter::read_calls);
+  completed_.emplace_back(b, n < 0 ? -errno : static_cast<int>(n));
+}
+
+std::error_code block_pipeline::reap() {
+  if (ring_.has_value()) {
+    {
+      const stats::scoped_timer timer(stats::stage::read);
+      if (const std::error_code ec = ring_->submit(1)) {
+        return ec;
+      }
+    }
+    while (const auto c = ring_->pop()) {
+      complete(static_cast<unsigned int>(c->user_data), c->result);
+    }
+    return {};
+  }
+  // Retries append to `completed_` while it is worked off.
+  for (std::size_t i = 0; i < completed_.size(); ++i) {
+    const auto [b, result] = completed_[i];
+    complete(b, result);
+  }
+  completed_.clear();
+  return {};
+}
+
+void block_pipeline::complete(unsigned int b, int result) {
+  --inflight_;
+  block& k = blocks_[b];
+  const log_file& f = files_[k.file];
+  if (error_.has_value()) {
+    free_.push(b);
+    return;
+  }
+  if (result == -EAGAIN || result == -EINTR) {
+    submit_read(b);
+    return;
+  }
+  if (result < 0) {
+    error_ = read_error(f.path, errno_code(-result));
+    free_.push(b);
+    return;
+  }
+  stats::add(stats::counter::bytes_read, static_cast<std::uint64_t>(result));
+  k.filled = std::min<std::uint32_t>(k.filled + result, k.size);
+  // Reads stop short at the end of a file that has been truncated since.
+  if (result != 0 && k.filled < k.size) {
+    submit_read(b);
+    return;
+  }
+  files_[k.file].done.emplace(k.offset, b);
+}
+
+// Passes on the completed blocks that are next in file order, and the last
+// line of every file that has been passed on entirely.
+void block_pipeline::advance() {
+  while (dispatch_file_ < opened_) {
+    log_file& f = files_[dispatch_file_];
+    auto it = f.done.begin();
+    while (it != f.done.end() && it->first == f.dispatched) {
+      f.dispatched += blocks_[it->second].size;
+      dispatch(f, it->second);
+      it = f.done.erase(it);
+    }
+    if (f.dispatched < f.size) {
+      return;
+    }
+    if (!f.carry.empty()) {
+      fn_(options_.threads, f.carry);
+      f.carry = std::string();
+    }
+    ::close(f.fd);
+    f.fd = -1;
+    ++dispatch_file_;
+  }
+}
+
+// Scans the line that the previous block left unterminated here and hands the
+// whole lines of the block to the workers.
+void block_pipeline::dispatch(log_file& f, unsigned int b) {
+  const std::string_view data(buffer(b), blocks_[b].filled);
+  const void* first = std::memchr(data.data(), '\n', data.size());
+  if (first == nullptr) {
+    f.carry.append(data);
+    free_.push(b);
+    return;
+  }
+  std::size_t begin = 0;
+  if (!f.carry.empty()) {
+    begin = static_cast<const char*>(first) - data.data() + 1;
+    f.carry.append(data.substr(0, begin));
+    fn_(options_.threads, f.carry);
+    f.carry.clear();
+  }
+  const std::size_t end =
+      static_cast<const char*>(::memrchr(data.data(), '\n', data.size())) -
+      data.data() + 1;
+  f.carry.assign(data.substr(end));
+  if (end == begin) {
+    free_.push(b);
+    return;
+  }
+  full_.push({b, data.substr(begin, end - begin)});
+}
+
+}  // namespace
+
+std::optional<io_backend> find_io_backend(std::string_view name) noexcept {
+  if (name == "mmap") return io_backend::mmap;
+  if (name == "read") return io_backend::read;
+  if (name == "uring") return io_backend::uring;
+  return std::nullopt;
+}
+
+tl::expected<void, std::runtime_error> read_lines(
+    std::span<const char* const> paths, const block_read_options& options,
+    const std::function<void(unsigned int, std::string_view)>& fn) {
+  block_pipeline pipeline(paths, options, fn);
+  return pipeline.run();
+}
+
+}  // namespace httpcode
@@ -0,0 +1,51 @@
+#ifndef HTTPCODE_BLOCK_READER_HPP_
+#define HTTPCODE_BLOCK_READER_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <tl/expected.hpp>
+
+namespace httpcode {
+
+/// Block reads
+//
+// Mapping large log sets makes every scan thread take page faults, and a
+// single sequential reader per file leaves fast disks mostly idle. The block
+// reader instead keeps a fixed number of reads in flight over a pool of
+// reusable aligned buffers, through io_uring where the kernel allows it and
+// with `pread` otherwise. The calling thread issues the reads and puts the
+// completed blocks back in file order, and a set of worker threads scans them.
+
+enum class io_backend { mmap, read, uring };
+
+// Returns the backend with the given name, or nothing if there is none.
+std::optional<io_backend> find_io_backend(std::string_view name) noexcept;
+
+struct block_read_options {
+  // `read` or `uring`. `uring` falls back to `read` if io_uring cannot be set
+  // up, and to unregistered buffers if they cannot be registered.
+  io_backend backend = io_backend::uring;
+  unsigned int threads = 1;
+  unsigned int queue_depth = 32;
+  // A multiple of 4096, as O_DIRECT needs.
+  std::size_t block_size = 512 << 10;
+  // Bypasses the page cache where the file system supports it.
+  bool direct = false;
+};
+
+// Reads the files at `paths` in blocks and calls `fn(worker, lines)` with
+// newline-aligned pieces of them, where `worker` is below `options.threads`
+// for calls on the worker threads and equal to it for calls on the calling
+// thread, which gets the lines that span two blocks. Each worker's calls are
+// sequential. Errors name the file they concern.
+tl::expected<void, std::runtime_error> read_lines(
+    std::span<const char* const> paths, const block_read_options& options,
+    const std::function<void(unsigned int, std::string_view)>& fn);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_BLOCK_READER_HPP_
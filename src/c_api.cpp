@@ -0,0 +1,39 @@
+#include "httpcode/status.h"
+
+#include <string_view>
+
+#include "httpcode/status.hpp"
+
+namespace {
+
+const char* c_string(std::string_view s, size_t* length) noexcept {
+  if (s.empty()) {
+    return nullptr;
+  }
+  if (length != nullptr) {
+    *length = s.size();
+  }
+  return s.data();
+}
+
+}  // namespace
+
+extern "C" {
+
+int httpcode_status_class(unsigned int code) {
+  return static_cast<int>(httpcode::classify(code));
+}
+
+int httpcode_is_known(unsigned int code) {
+  return httpcode::is_known(code) ? 1 : 0;
+}
+
+const char* httpcode_reason_phrase(unsigned int code, size_t* length) {
+  return c_string(httpcode::reason_phrase(code), length);
+}
+
+const char* httpcode_status_line(unsigned int code, size_t* length) {
+  return c_string(httpcode::status_line(code), length);
+}
+
+}  // extern "C"
@@ -0,0 +1,379 @@
+#include "client.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "output_buffer.hpp"
+
+namespace httpcode {
+
+namespace {
+
+std::error_code last_error() noexcept {
+  return std::error_code(errno, std::generic_category());
+}
+
+tl::expected<int, std::error_code> connect_unix(const char* path) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (std::strlen(path) >= sizeof(addr.sun_path)) {
+    return tl::make_unexpected(
+        std::make_error_code(std::errc::filename_too_long));
+  }
+  std::strcpy(addr.sun_path, path);
+
+  const int fd =
+      ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return tl::make_unexpected(last_error());
+  }
+  // Connecting a UNIX socket completes immediately or fails; there is no
+  // in-progress state to wait for.
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) !=
+      0) {
+    const std::error_code error = last_error();
+    ::close(fd);
+    return tl::make_unexpected(error);
+  }
+  return fd;
+}
+
+// Incremental parser for the daemon's `OK|ERR <length>\n<body>` responses.
+class response_parser {
+ public:
+  // Consumes `data`, calling `on_body(chunk, ok)` for every piece of a body
+  // and `on_end(ok)` after every complete response. Returns false if a header
+  // is malformed.
+  template <typename OnBody, typename OnEnd>
+  bool feed(std::string_view data, OnBody&& on_body, OnEnd&& on_end) {
+    while (!data.empty()) {
+      if (in_body_) {
+        const std::size_t n = std::min(remaining_, data.size());
+        if (n != 0) {
+          on_body(data.substr(0, n), ok_);
+        }
+        data.remove_prefix(n);
+        remaining_ -= n;
+        if (remaining_ == 0) {
+          in_body_ = false;
+          on_end(ok_);
+        }
+        continue;
+      }
+
+      const std::size_t nl = data.find('\n');
+      const std::size_t n = nl == std::string_view::npos ? data.size() : nl;
+      if (header_size_ + n > header_.size()) {
+        return false;
+      }
+      std::memcpy(header_.data() + header_size_, data.data(), n);
+      header_size_ += n;
+      data.remove_prefix(n);
+      if (nl == std::string_view::npos) {
+        continue;
+      }
+      data.remove_prefix(1);
+      if (!parse_header()) {
+        return false;
+      }
+      in_body_ = true;
+      if (remaining_ == 0) {
+        in_body_ = false;
+        on_end(ok_);
+      }
+    }
+    return true;
+  }
+
+ private:
+  bool parse_header() noexcept {
+    std::string_view header(header_.data(), header_size_);
+    header_size_ = 0;
+    if (header.starts_with("OK ")) {
+      ok_ = true;
+      header.remove_prefix(3);
+    } else if (header.starts_with("ERR ")) {
+      ok_ = false;
+      header.remove_prefix(4);
+    } else {
+      return false;
+    }
+    const auto [end, ec] = std::from_chars(
+        header.data(), header.data() + header.size(), remaining_);
+    return ec == std::errc() && end == header.data() + header.size();
+  }
+
+  std::array<char, 32> header_;
+  std::size_t header_size_ = 0;
+  std::size_t remaining_ = 0;
+  bool in_body_ = false;
+  bool ok_ = false;
+};
+
+}  // namespace
+
+tl::expected<bool, std::error_code> run_client(
+    const char* socket_path, std::span<const std::string_view> requests) {
+  const auto fd = connect_unix(socket_path);
+  if (!fd.has_value()) {
+    return tl::make_unexpected(fd.error());
+  }
+
+  std::string pending;
+  for (const std::string_view request : requests) {
+    pending += request;
+    pending += '\n';
+  }
+  std::size_t sent = 0;
+  bool input_done = !requests.empty();
+  bool shut_down = false;
+  bool all_ok = true;
+
+  output_buffer out(STDOUT_FILENO);
+  output_buffer err(STDERR_FILENO);
+  response_parser parser;
+  std::array<char, 64 * 1024> buffer;
+  std::error_code error;
+
+  for (;;) {
+    if (input_done && sent == pending.size() && !shut_down) {
+      ::shutdown(*fd, SHUT_WR);
+      shut_down = true;
+    }
+
+    std::array<pollfd, 2> fds{};
+    fds[0].fd = *fd;
+    fds[0].events = POLLIN | (sent < pending.size() ? POLLOUT : 0);
+    fds[1].fd = input_done || sent < pending.size() ? -1 : STDIN_FILENO;
+    fds[1].events = POLLIN;
+    if (::poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      error = last_error();
+      break;
+    }
+
+    if (fds[1].revents != 0) {
+      const ssize_t n = ::read(STDIN_FILENO, buffer.data(), buffer.size());
+      if (n < 0 && errno != EINTR) {
+        error = last_error();
+        break;
+      }
+      if (n == 0) {
+        input_done = true;
+      } else if (n > 0) {
+        pending.assign(buffer.data(), static_cast<std::size_t>(n));
+        sent = 0;
+      }
+    }
+
+    if ((fds[0].revents & POLLOUT) != 0) {
+      const ssize_t n = ::send(*fd, pending.data() + sent,
+                               pending.size() - sent, MSG_NOSIGNAL);
+      if (n < 0 && errno != EAGAIN && errno != EINTR) {
+        error = last_error();
+        break;
+      }
+      sent += n > 0 ? static_cast<std::size_t>(n) : 0;
+    }
+
+    if ((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+      const ssize_t n = ::read(*fd, buffer.data(), buffer.size());
+      if (n < 0) {
+        if (errno == EAGAIN || errno == EINTR) continue;
+        error = last_error();
+        break;
+      }
+      if (n == 0) {
+        break;
+      }
+      const bool valid = parser.feed(
+          std::string_view(buffer.data(), static_cast<std::size_t>(n)),
+          [&](std::string_view body, bool ok) {
+            (ok ? out : err).append(body);
+          },
+          [&](bool ok) { all_ok &= ok; });
+      if (!valid) {
+        error = std::make_error_code(std::errc::bad_message);
+        break;
+      }
+    }
+  }
+
+  ::close(*fd);
+  out.flush();
+  err.flush();
+  if (error) {
+    return tl::make_unexpected(error);
+  }
+  return all_ok;
+}
+
+tl::expected<void, std::error_code> run_load(const char* socket_path,
+                                             const load_options& options) {
+  using clock = std::chrono::steady_clock;
+
+  struct load_connection {
+    int fd = -1;
+    response_parser parser;
+    // Send times of the requests in flight, oldest first.
+    std::vector<clock::time_point> sent_at;
+    std::size_t oldest = 0;
+    std::size_t in_flight = 0;
+    std::string pending;
+    std::size_t pending_sent = 0;
+  };
+
+  const std::string request = std::string(options.request) + '\n';
+  const unsigned int depth = std::max(options.depth, 1u);
+  std::vector<load_connection> connections(std::max(options.connections, 1u));
+  std::vector<pollfd> fds(connections.size());
+  for (std::size_t i = 0; i < connections.size(); ++i) {
+    const auto fd = connect_unix(socket_path);
+    if (!fd.has_value()) {
+      for (const auto& conn : connections) {
+        if (conn.fd >= 0) ::close(conn.fd);
+      }
+      return tl::make_unexpected(fd.error());
+    }
+    connections[i].fd = *fd;
+    connections[i].sent_at.resize(depth);
+    fds[i].fd = *fd;
+  }
+
+  std::vector<std::uint64_t> latencies;
+  latencies.reserve(options.requests);
+  std::size_t issued = 0;
+  std::array<char, 64 * 1024> buffer;
+  std::error_code error;
+  const clock::time_point start = clock::now();
+
+  while (latencies.size() < options.requests && !error) {
+    for (std::size_t i = 0; i < connections.size(); ++i) {
+      load_connection& conn = connections[i];
+      if (conn.pending_sent == conn.pending.size()) {
+        conn.pending.clear();
+        conn.pending_sent = 0;
+      }
+      while (conn.in_flight < depth && issued < options.requests) {
+        conn.sent_at[(conn.oldest + conn.in_flight) % depth] = clock::now();
+        conn.pending += request;
+        ++conn.in_flight;
+        ++issued;
+      }
+      fds[i].events = POLLIN;
+      if (conn.pending_sent < conn.pending.size()) {
+        const ssize_t n =
+            ::send(conn.fd, conn.pending.data() + conn.pending_sent,
+                   conn.pending.size() - conn.pending_sent, MSG_NOSIGNAL);
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+          error = last_error();
+          break;
+        }
+        conn.pending_sent += n > 0 ? static_cast<std::size_t>(n) : 0;
+        if (conn.pending_sent < conn.pending.size()) {
+          fds[i].events |= POLLOUT;
+        }
+      }
+    }
+    if (error) {
+      break;
+    }
+
+    if (::poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      error = last_error();
+      break;
+    }
+
+    for (std::size_t i = 0; i < connections.size(); ++i) {
+      if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+        continue;
+      }
+      load_connection& conn = connections[i];
+      const ssize_t n = ::read(conn.fd, buffer.data(), buffer.size());
+      if (n < 0) {
+        if (errno == EAGAIN || errno == EINTR) continue;
+        error = last_error();
+        break;
+      }
+      if (n == 0) {
+        error = std::make_error_code(std::errc::connection_reset);
+        break;
+      }
+      const clock::time_point now = clock::now();
+      const bool valid = conn.parser.feed(
+          std::string_view(buffer.data(), static_cast<std::size_t>(n)),
+          [](std::string_view, bool) {},
+          [&](bool) {
+            latencies.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    now - conn.sent_at[conn.oldest])
+                    .count());
+            conn.oldest = (conn.oldest + 1) % depth;
+            --conn.in_flight;
+          });
+      if (!valid) {
+        error = std::make_error_code(std::errc::bad_message);
+        break;
+      }
+    }
+  }
+
+  const double seconds =
+      std::chrono::duration<double>(clock::now() - start).count();
+  for (const auto& conn : connections) {
+    ::close(conn.fd);
+  }
+  if (error) {
+    return tl::make_unexpected(error);
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  const auto percentile = [&](double p) -> std::uint64_t {
+    if (latencies.empty()) return 0;
+    return latencies[static_cast<std::size_t>(p * (latencies.size() - 1))];
+  };
+  // Prints a nanosecond latency in microseconds with one decimal.
+  const auto append_us = [](output_buffer& out, std::uint64_t ns) {
+    out.append(ns / 1000);
+    out.append('.');
+    out.append(static_cast<unsigned int>(ns / 100 % 10));
+    out.append(" us\n");
+  };
+
+  output_buffer out(STDOUT_FILENO);
+  out.append("requests:    ");
+  out.append(std::uint64_t{latencies.size()});
+  out.append("\nconnections: ");
+  out.append(std::uint64_t{connections.size()});
+  out.append("\ndepth:       ");
+  out.append(depth);
+  out.append("\nelapsed:     ");
+  out.append(static_cast<std::uint64_t>(seconds * 1000));
+  out.append(" ms\nrequests/s:  ");
+  out.append(static_cast<std::uint64_t>(latencies.size() / seconds));
+  out.append("\np50:         ");
+  append_us(out, percentile(0.50));
+  out.append("p99:         ");
+  append_us(out, percentile(0.99));
+  out.append("p99.9:       ");
+  append_us(out, percentile(0.999));
+  out.append("max:         ");
+  append_us(out, percentile(1.0));
+  return {};
+}
+
+}  // namespace httpcode
@@ -0,0 +1,35 @@
+#ifndef HTTPCODE_CLIENT_HPP_
+#define HTTPCODE_CLIENT_HPP_
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <tl/expected.hpp>
+
+namespace httpcode {
+
+// Sends `requests` to the lookup daemon at `socket_path`, pipelined over one
+// connection, and writes each response body to stdout (or stderr for errors).
+// With no requests, request lines are read from stdin instead. Returns whether
+// every request was answered with OK.
+tl::expected<bool, std::error_code> run_client(
+    const char* socket_path, std::span<const std::string_view> requests);
+
+// Parameters of a local load test against the lookup daemon.
+struct load_options {
+  unsigned int connections = 4;
+  unsigned int depth = 16;
+  std::size_t requests = 1'000'000;
+  std::string_view request = "404";
+};
+
+// Drives the daemon at `socket_path` with `options.connections` connections,
+// each keeping `options.depth` requests in flight, and prints requests per
+// second and latency percentiles to stdout.
+tl::expected<void, std::error_code> run_load(const char* socket_path,
+                                             const load_options& options);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_CLIENT_HPP_
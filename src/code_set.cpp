@@ -0,0 +1,98 @@
+#include "code_set.hpp"
+
+#include <optional>
+#include <string>
+
+namespace httpcode {
+
+namespace {
+
+constexpr bool is_digit(char c) noexcept { return c >= '0' && c <= '9'; }
+
+// Parses exactly three digits.
+std::optional<unsigned int> parse_code(std::string_view s) noexcept {
+  if (s.size() != 3 || !is_digit(s[0]) || !is_digit(s[1]) || !is_digit(s[2])) {
+    return std::nullopt;
+  }
+  return (s[0] - '0') * 100 + (s[1] - '0') * 10 + (s[2] - '0');
+}
+
+// Returns the codes selected by a single term without its '-' prefix.
+std::optional<code_set> parse_term(std::string_view term) noexcept {
+  code_set s;
+  if (const category* c = find_category(term)) {
+    s.insert_range(c->first_code, c->last_code);
+    return s;
+  }
+
+  const std::size_t dash = term.find('-');
+  if (dash != std::string_view::npos) {
+    const auto first = parse_code(term.substr(0, dash));
+    const auto last = parse_code(term.substr(dash + 1));
+    if (!first.has_value() || !last.has_value() || *first > *last) {
+      return std::nullopt;
+    }
+    s.insert_range(*first, *last);
+    return s;
+  }
+
+  if (term.size() != 3) {
+    return std::nullopt;
+  }
+  for (const char c : term) {
+    if (!is_digit(c) && c != 'x' && c != 'X') {
+      return std::nullopt;
+    }
+  }
+  // Each digit of the pattern is either fixed or ranges over 0-9.
+  const auto low = [&](std::size_t i) {
+    return is_digit(term[i]) ? static_cast<unsigned int>(term[i] - '0') : 0u;
+  };
+  const auto high = [&](std::size_t i) {
+    return is_digit(term[i]) ? static_cast<unsigned int>(term[i] - '0') : 9u;
+  };
+  for (unsigned int a = low(0); a <= high(0); ++a) {
+    for (unsigned int b = low(1); b <= high(1); ++b) {
+      s.insert_range(a * 100 + b * 10 + low(2), a * 100 + b * 10 + high(2));
+    }
+  }
+  return s;
+}
+
+}  // namespace
+
+tl::expected<code_set, std::invalid_argument> parse_code_query(
+    std::string_view query) {
+  code_set included;
+  code_set excluded;
+  bool any_included = false;
+  while (true) {
+    const std::size_t comma = query.find(',');
+    std::string_view term = query.substr(0, comma);
+    const bool exclude = term.starts_with('-');
+    if (exclude) {
+      term.remove_prefix(1);
+    }
+    const auto codes = parse_term(term);
+    if (!codes.has_value()) {
+      return tl::make_unexpected(std::invalid_argument(
+          "Invalid code query term '" + std::string(term) + "'."));
+    }
+    if (exclude) {
+      excluded |= *codes;
+    } else {
+      included |= *codes;
+      any_included = true;
+    }
+    if (comma == std::string_view::npos) {
+      break;
+    }
+    query.remove_prefix(comma + 1);
+  }
+
+  code_set result = any_included ? included : code_set::all();
+  result -= excluded;
+  return result;
+}
+
+}  // namespace httpcode
@@ -0,0 +1,131 @@
+#ifndef HTTPCODE_CODE_SET_HPP_
+#define HTTPCODE_CODE_SET_HPP_
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <tl/expected.hpp>
+
+#include "httpcode/codes.hpp"
+
+namespace httpcode {
+
+/// Code queries
+//
+// A query selects three-digit status codes with a comma-separated list of
+// terms:
+//
+//   404          a single code
+//   500-511      an inclusive range
+//   5xx, 50x     a pattern in which x matches any digit
+//   client-error a category name, as accepted by `list`
+//   -404         any of the above prefixed with '-' excludes its codes
+//
+// The result is the union of all included terms without the union of all
+// excluded ones. A query that only excludes starts from every code.
+
+// Set of the codes [0, 999] as a bitset of 64-bit words, so that membership is
+// a single bit test and set operations work a word at a time.
+class code_set {
+ public:
+  static constexpr unsigned int size = 1000;
+
+  constexpr code_set() noexcept = default;
+
+  static constexpr code_set all() noexcept {
+    code_set s;
+    s.insert_range(0, size - 1);
+    return s;
+  }
+
+  constexpr bool contains(unsigned int code) const noexcept {
+    return code < size && ((words_[code >> 6] >> (code & 63)) & 1) != 0;
+  }
+
+  constexpr void insert(unsigned int code) noexcept {
+    words_[code >> 6] |= std::uint64_t{1} << (code & 63);
+  }
+
+  // Inserts [first, last], filling whole words at once.
+  constexpr void insert_range(unsigned int first, unsigned int last) noexcept {
+    for (unsigned int w = first >> 6; w <= last >> 6; ++w) {
+      const unsigned int lo = w == first >> 6 ? first & 63 : 0;
+      const unsigned int hi = w == last >> 6 ? last & 63 : 63;
+      words_[w] |= (~std::uint64_t{0} >> (63 - hi)) & (~std::uint64_t{0} << lo);
+    }
+  }
+
+  constexpr code_set& operator|=(const code_set& other) noexcept {
+    for (std::size_t w = 0; w < words_.size(); ++w) {
+      words_[w] |= other.words_[w];
+    }
+    return *this;
+  }
+
+  constexpr code_set& operator&=(const code_set& other) noexcept {
+    for (std::size_t w = 0; w < words_.size(); ++w) {
+      words_[w] &= other.words_[w];
+    }
+    return *this;
+  }
+
+  // Removes every code of `other`.
+  constexpr code_set& operator-=(const code_set& other) noexcept {
+    for (std::size_t w = 0; w < words_.size(); ++w) {
+      words_[w] &= ~other.words_[w];
+    }
+    return *this;
+  }
+
+  constexpr std::size_t count() const noexcept {
+    std::size_t n = 0;
+    for (const std::uint64_t word : words_) n += std::popcount(word);
+    return n;
+  }
+
+  constexpr bool empty() const noexcept { return count() == 0; }
+
+  // Calls `fn` with every code in the set, in ascending order.
+  template <typename Fn>
+  constexpr void for_each(Fn&& fn) const {
+    for (std::size_t w = 0; w < words_.size(); ++w) {
+      for (std::uint64_t word = words_[w]; word != 0; word &= word - 1) {
+        fn(static_cast<unsigned int>(w * 64 + std::countr_zero(word)));
+      }
+    }
+  }
+
+  constexpr bool operator==(const code_set&) const noexcept = default;
+
+ private:
+  std::array<std::uint64_t, (size + 63) / 64> words_{};
+};
+
+// The codes of the built-in table.
+inline constexpr code_set known_codes = [] {
+  code_set s;
+  for (const auto& [code, _] : code_entries) s.insert(code);
+  return s;
+}();
+
+static_assert(known_codes.count() == std::size(code_entries));
+static_assert(code_set::all().count() == code_set::size);
+static_assert([] {
+  code_set s;
+  s.insert_range(60, 130);
+  unsigned int expected = 60;
+  bool ok = s.count() == 71;
+  s.for_each([&](unsigned int code) { ok = ok && code == expected++; });
+  return ok && !s.contains(59) && !s.contains(131);
+}());
+
+// Parses a query as described above. Errors name the offending term.
+tl::expected<code_set, std::invalid_argument> parse_code_query(
+    std::string_view query);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_CODE_SET_HPP_
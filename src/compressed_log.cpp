@@ -0,0 +1,257 @@
+#include "compressed_log.hpp"
+
+#include <zlib.h>
+#include <zstd.h>
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "stats.hpp"
+
+namespace httpcode {
+
+namespace {
+
+// Each pipeline owns `buffer_count` buffers of `buffer_size` bytes, which
+// bounds how far the decompress stage can run ahead of the scan stage.
+constexpr std::size_t buffer_size = 1 << 20;
+constexpr std::size_t buffer_count = 4;
+
+struct chunk {
+  char* data;
+  std::size_t size;
+};
+
+// Blocking FIFO of chunks. It never holds more than `buffer_count` of them,
+// since that is how many buffers there are.
+class chunk_queue {
+ public:
+  void push(chunk c) {
+    {
+      const std::lock_guard lock(mutex_);
+      items_[(head_ + count_) % items_.size()] = c;
+      ++count_;
+    }
+    ready_.notify_one();
+  }
+
+  // Returns the next chunk, or nothing once the queue is closed and empty.
+  std::optional<chunk> pop() {
+    std::unique_lock lock(mutex_);
+    ready_.wait(lock, [&] { return count_ != 0 || closed_; });
+    if (count_ == 0) {
+      return std::nullopt;
+    }
+    const chunk c = items_[head_];
+    head_ = (head_ + 1) % items_.size();
+    --count_;
+    return c;
+  }
+
+  void close() {
+    {
+      const std::lock_guard lock(mutex_);
+      closed_ = true;
+    }
+    ready_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::array<chunk, buffer_count> items_;
+  std::size_t head_ = 0;
+  std::size_t count_ = 0;
+  bool closed_ = false;
+};
+
+// Inflates gzip data, including files made of several concatenated members.
+class gzip_decoder {
+ public:
+  explicit gzip_decoder(std::string_view data) noexcept : rest_(data) {
+    // 32 lets zlib detect the gzip header.
+    ok_ = inflateInit2(&stream_, 15 + 32) == Z_OK;
+  }
+  gzip_decoder(const gzip_decoder&) = delete;
+  gzip_decoder& operator=(const gzip_decoder&) = delete;
+  ~gzip_decoder() {
+    if (ok_) inflateEnd(&stream_);
+  }
+
+  // Fills `out` with up to `size` bytes and returns how many were written,
+  // which is 0 at the end of the data.
+  tl::expected<std::size_t, std::runtime_error> read(char* out,
+                                                     std::size_t size) {
+    if (!ok_) {
+      return tl::make_unexpected(std::runtime_error("out of memory"));
+    }
+    stream_.next_out = reinterpret_cast<Bytef*>(out);
+    stream_.avail_out = static_cast<uInt>(size);
+    while (stream_.avail_out != 0 && !done_) {
+      if (stream_.avail_in == 0) {
+        // avail_in is 32 bits wide, so large inputs are fed in pieces.
+        const std::size_t n = std::min<std::size_t>(rest_.size(), 1u << 30);
+        stream_.next_in =
+            reinterpret_cast<Bytef*>(const_cast<char*>(rest_.data()));
+        stream_.avail_in = static_cast<uInt>(n);
+        rest_.remove_prefix(n);
+      }
+      const int ret = inflate(&stream_, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END) {
+        done_ = stream_.avail_in == 0 && rest_.empty();
+        if (!done_) inflateReset(&stream_);
+      } else if (ret == Z_BUF_ERROR && stream_.avail_in == 0 &&
+                 rest_.empty()) {
+        return tl::make_unexpected(std::runtime_error("truncated gzip data"));
+      } else if (ret != Z_OK) {
+        return tl::make_unexpected(std::runtime_error("corrupt gzip data"));
+      }
+    }
+    return size - stream_.avail_out;
+  }
+
+ private:
+  z_stream stream_{};
+  std::string_view rest_;
+  bool ok_ = false;
+  bool done_ = false;
+};
+
+// Decompresses zstd data, including files made of several frames.
+class zstd_decoder {
+ public:
+  explicit zstd_decoder(std::string_view data) noexcept
+      : context_(ZSTD_createDCtx()), input_{data.data(), data.size(), 0} {}
+  zstd_decoder(const zstd_decoder&) = delete;
+  zstd_decoder& operator=(const zstd_decoder&) = delete;
+  ~zstd_decoder() { ZSTD_freeDCtx(context_); }
+
+  // Fills `out` with up to `size` bytes and returns how many were written,
+  // which is 0 at the end of the data.
+  tl::expected<std::size_t, std::runtime_error> read(char* out,
+                                                     std::size_t size) {
+    if (context_ == nullptr) {
+      return tl::make_unexpected(std::runtime_error("out of memory"));
+    }
+    ZSTD_outBuffer output{out, size, 0};
+    while (output.pos < output.size &&
+           (input_.pos < input_.size || !frame_done_)) {
+      const std::size_t before = output.pos;
+      const std::size_t ret = ZSTD_decompressStream(context_, &output, &input_);
+      if (ZSTD_isError(ret)) {
+        return tl::make_unexpected(std::runtime_error(
+            std::string("corrupt zstd data: ") + ZSTD_getErrorName(ret)));
+      }
+      frame_done_ = ret == 0;
+      if (input_.pos == input_.size && output.pos == before && !frame_done_) {
+        return tl::make_unexpected(std::runtime_error("truncated zstd data"));
+      }
+    }
+    return output.pos;
+  }
+
+ private:
+  ZSTD_DCtx* context_;
+  ZSTD_inBuffer input_;
+  // Whether the last frame has been completely decoded and flushed.
+  bool frame_done_ = true;
+};
+
+// The decompress stage: fills free buffers with output that ends on a line
+// boundary and passes them on in order. The unterminated line at the end of a
+// buffer is carried over to the start of the next one.
+template <typename Decoder>
+tl::expected<void, std::runtime_error> decompress_into(Decoder& decoder,
+                                                       chunk_queue& free,
+                                                       chunk_queue& full) {
+  char* buffer = free.pop()->data;
+  std::size_t used = 0;
+  for (;;) {
+    const auto n = decoder.read(buffer + used, buffer_size - used);
+    if (!n.has_value()) {
+      return tl::make_unexpected(n.error());
+    }
+    used += *n;
+    if (*n == 0) {
+      if (used != 0) full.push({buffer, used});
+      return {};
+    }
+    if (used < buffer_size) {
+      continue;
+    }
+
+    const void* nl = ::memrchr(buffer, '\n', used);
+    // A line longer than a whole buffer is passed on in pieces.
+    const std::size_t end =
+        nl != nullptr ? static_cast<const char*>(nl) - buffer + 1 : used;
+    char* next = free.pop()->data;
+    std::memcpy(next, buffer + end, used - end);
+    full.push({buffer, end});
+    buffer = next;
+    used -= end;
+  }
+}
+
+}  // namespace
+
+compression detect_compression(std::string_view data) noexcept {
+  if (data.starts_with("\x1f\x8b")) {
+    return compression::gzip;
+  }
+  if (data.starts_with("\x28\xb5\x2f\xfd")) {
+    return compression::zstd;
+  }
+  return compression::none;
+}
+
+tl::expected<void, std::runtime_error> decompress_lines(
+    std::string_view data, compression kind,
+    const std::function<void(std::string_view)>& fn) {
+  if (kind == compression::none) {
+    fn(data);
+    return {};
+  }
+
+  const auto buffers = std::make_unique<char[]>(buffer_size * buffer_count);
+  chunk_queue free;
+  chunk_queue full;
+  for (std::size_t i = 0; i < buffer_count; ++i) {
+    free.push({buffers.get() + i * buffer_size, 0});
+  }
+
+  std::optional<std::runtime_error> error;
+  std::thread decompressor([&] {
+    const stats::scoped_timer timer(stats::stage::decompress);
+    tl::expected<void, std::runtime_error> result;
+    if (kind == compression::gzip) {
+      gzip_decoder decoder(data);
+      result = decompress_into(decoder, free, full);
+    } else {
+      zstd_decoder decoder(data);
+      result = decompress_into(decoder, free, full);
+    }
+    if (!result.has_value()) {
+      error = result.error();
+    }
+    full.close();
+  });
+
+  while (const auto c = full.pop()) {
+    fn(std::string_view(c->data, c->size));
+    free.push(*c);
+  }
+  decompressor.join();
+  if (error.has_value()) {
+    return tl::make_unexpected(*error);
+  }
+  return {};
+}
+
+}  // namespace httpcode
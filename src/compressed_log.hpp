@@ -0,0 +1,30 @@
+#ifndef HTTPCODE_COMPRESSED_LOG_HPP_
+#define HTTPCODE_COMPRESSED_LOG_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <tl/expected.hpp>
+
+namespace httpcode {
+
+/// Compressed logs
+
+enum class compression { none, gzip, zstd };
+
+// Recognizes gzip and zstd data by their magic numbers.
+compression detect_compression(std::string_view data) noexcept;
+
+// Decompresses `data` on a separate thread and calls `fn` on the calling
+// thread with consecutive pieces of the output, each of which ends just after
+// a newline (except possibly the last). The two stages hand buffers to each
+// other through a bounded queue, so memory use does not depend on the size of
+// the input and either stage can run ahead of the other by a few buffers.
+tl::expected<void, std::runtime_error> decompress_lines(
+    std::string_view data, compression kind,
+    const std::function<void(std::string_view)>& fn);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_COMPRESSED_LOG_HPP_
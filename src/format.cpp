@@ -0,0 +1,420 @@
+#include "format.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+#include "rendered.hpp"
+#include "stats.hpp"
+
+namespace httpcode {
+
+tl::expected<int, std::errc> to_digit(std::string_view s) noexcept {
+  const stats::scoped_timer timer(stats::stage::parse);
+  int value = 0;
+  const auto [_, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+  if (ec != std::errc()) {
+    stats::add(stats::counter::parse_failures);
+    return tl::make_unexpected(ec);
+  }
+  return value;
+}
+
+std::string format_output(unsigned int code, std::string_view short_desc,
+                          std::string_view long_desc,
+                          std::string_view learn_more_url) noexcept {
+  constexpr std::string_view learn_more = "\n\nLearn more: ";
+  std::string output;
+  output.reserve(5 + short_desc.size() + long_desc.size() + learn_more.size() +
+                 learn_more_url.size());
+  output += std::to_string(code);
+  output += ' ';
+  output += short_desc;
+  output += '\n';
+  output += long_desc;
+  output += learn_more;
+  output += learn_more_url;
+  output += '\n';
+  return output;
+}
+
+namespace {
+
+// Appends `code` with the leading zeros of a three-digit code.
+void append_padded_code(output_buffer& out, unsigned int code) noexcept {
+  if (code < 100) out.append('0');
+  if (code < 10) out.append('0');
+  out.append(code);
+}
+
+}  // namespace
+
+void append_output(output_buffer& out, unsigned int code,
+                   const description& desc) noexcept {
+  const stats::scoped_timer timer(stats::stage::render);
+  const auto& [short_desc, long_desc, learn_more_url] = desc;
+  append_padded_code(out, code);
+  out.append(' ');
+  out.append(short_desc);
+  out.append('\n');
+  out.append(long_desc);
+  out.append("\n\nLearn more: ");
+  out.append(learn_more_url);
+  out.append('\n');
+}
+
+std::string_view list_all_codes() noexcept { return rendered_list(); }
+
+tl::expected<std::string_view, std::exception> list_all_codes_for_category(
+    std::string_view category) noexcept {
+  const auto* c = find_category(category);
+  if (c == nullptr) {
+    return tl::make_unexpected(std::invalid_argument("Invalid category name."));
+  }
+  return rendered_category(*c);
+}
+
+namespace {
+
+void append_list_entries(output_buffer& out, const registry& names,
+                         unsigned int first_code,
+                         unsigned int last_code) noexcept {
+  for (unsigned int code = first_code; code <= last_code; ++code) {
+    const auto desc = names.find(code);
+    if (desc.has_value()) {
+      append_padded_code(out, code);
+      out.append(' ');
+      out.append(std::get<0>(*desc));
+      out.append('\n');
+    }
+  }
+}
+
+// Appends the request time quantiles of `code`, if there are any.
+void append_latencies(output_buffer& out, const latency_counts* latencies,
+                      unsigned int code) noexcept {
+  if (latencies == nullptr || latencies->codes[code] == nullptr) {
+    return;
+  }
+  const latency_histogram& h = *latencies->codes[code];
+  for (std::size_t i = 0; i < latency_quantiles.size(); ++i) {
+    out.append(' ');
+    out.append(latency_quantile_names[i]);
+    out.append('=');
+    append_duration(out, h.quantile(latency_quantiles[i]));
+  }
+}
+
+// Appends the top keys of `code`, if there are any, indented past the count
+// column.
+void append_top_keys(output_buffer& out, const top_keys* top,
+                     unsigned int code, std::size_t width) noexcept {
+  if (top == nullptr) {
+    return;
+  }
+  for (const space_saving::entry& e : top->top(code)) {
+    for (std::size_t i = 0; i <= width; ++i) out.append(' ');
+    out.append(e.count, width);
+    out.append(' ');
+    out.append(e.key);
+    if (e.error != 0) {
+      out.append(" \u00b1");
+      out.append(e.error);
+    }
+    out.append('\n');
+  }
+}
+
+// Appends a share as a percentage with two decimals.
+void append_percent(output_buffer& out, double share) noexcept {
+  const auto hundredths = static_cast<std::uint64_t>(std::llround(
+      std::max(share, 0.0) * 10000));
+  out.append(hundredths / 100);
+  out.append('.');
+  out.append(static_cast<char>('0' + hundredths / 10 % 10));
+  out.append(static_cast<char>('0' + hundredths % 10));
+  out.append('%');
+}
+
+// Appends "count ±margin ", padded to `width` and `margin_width` columns, to
+// be followed by the label of the estimate.
+void append_count_estimate(output_buffer& out, const sample_estimate::value& v,
+                           std::size_t width,
+                           std::size_t margin_width) noexcept {
+  const auto count = static_cast<std::uint64_t>(std::llround(v.count));
+  out.append(count, width);
+  out.append(" \u00b1");
+  std::size_t used = 1;
+  if (v.count_margin < 0) {
+    out.append('?');
+  } else {
+    const auto margin = static_cast<std::uint64_t>(std::llround(v.count_margin));
+    out.append(margin);
+    for (std::uint64_t n = margin; n >= 10; n /= 10) ++used;
+  }
+  for (; used <= margin_width; ++used) out.append(' ');
+}
+
+// Appends " (share ±margin)" and ends the line.
+void append_share_estimate(output_buffer& out,
+                           const sample_estimate::value& v) noexcept {
+  out.append(" (");
+  append_percent(out, v.share);
+  out.append(" \u00b1");
+  if (v.share_margin < 0) {
+    out.append('?');
+  } else {
+    append_percent(out, v.share_margin);
+  }
+  out.append(")\n");
+}
+
+}  // namespace
+
+void append_duration(output_buffer& out, std::uint64_t micros) noexcept {
+  if (micros < 1000) {
+    out.append(micros);
+    out.append("us");
+    return;
+  }
+  const std::uint64_t tenths = (micros + 50) / 100;
+  if (tenths < 10000) {
+    out.append(tenths / 10);
+    out.append('.');
+    out.append(static_cast<char>('0' + tenths % 10));
+    out.append("ms");
+    return;
+  }
+  const std::uint64_t hundredths = (micros + 5000) / 10000;
+  out.append(hundredths / 100);
+  out.append('.');
+  out.append(static_cast<char>('0' + hundredths / 10 % 10));
+  out.append(static_cast<char>('0' + hundredths % 10));
+  out.append('s');
+}
+
+void append_list(output_buffer& out, const registry& names) noexcept {
+  const stats::scoped_timer timer(stats::stage::render);
+  out.append(detail::list_heading);
+  append_list_entries(out, names, 0, registry_max_code);
+}
+
+void append_category_list(output_buffer& out, const registry& names,
+                          const category& c) noexcept {
+  const stats::scoped_timer timer(stats::stage::render);
+  out.append(c.heading);
+  append_list_entries(out, names, c.first_code, c.last_code);
+}
+
+void append_query_list(output_buffer& out, const registry& names,
+                       const code_set& selected) noexcept {
+  const stats::scoped_timer timer(stats::stage::render);
+  for (const category& c : categories) {
+    code_set in_category;
+    in_category.insert_range(c.first_code, c.last_code);
+    in_category &= selected;
+    bool heading = false;
+    in_category.for_each([&](unsigned int code) {
+      const auto desc = names.find(code);
+      if (!desc.has_value()) {
+        return;
+      }
+      if (!heading) {
+        out.append(c.heading);
+        heading = true;
+      }
+      out.append(code);
+      out.append(' ');
+      out.append(std::get<0>(*desc));
+      out.append('\n');
+    });
+  }
+
+  // Codes that a registry defines outside of the categories.
+  bool heading = false;
+  selected.for_each([&](unsigned int code) {
+    if (code >= min_code && code <= max_code) {
+      return;
+    }
+    const auto desc = names.find(code);
+    if (!desc.has_value()) {
+      return;
+    }
+    if (!heading) {
+      out.append(other_heading);
+      heading = true;
+    }
+    append_padded_code(out, code);
+    out.append(' ');
+    out.append(std::get<0>(*desc));
+    out.append('\n');
+  });
+}
+
+void append_histogram(output_buffer& out, const status_counts& counts,
+                      const registry& names,
+                      const latency_counts* latencies,
+                      const top_keys* top) noexcept {
+  const stats::scoped_timer timer(stats::stage::render);
+  std::uint64_t max_count = counts.malformed;
+  for (const std::uint64_t count : counts.codes) {
+    max_count = std::max(max_count, count);
+  }
+  std::size_t width = 1;
+  for (std::uint64_t n = max_count; n >= 10; n /= 10) {
+    ++width;
+  }
+
+  for (const category& c : categories) {
+    bool heading = false;
+    for (unsigned int code = c.first_code; code <= c.last_code; ++code) {
+      const auto desc = names.find(code);
+      if (counts.codes[code] == 0 || !desc.has_value()) {
+        continue;
+      }
+      if (!heading) {
+        out.append(c.heading);
+        heading = true;
+      }
+      out.append(counts.codes[code], width);
+      out.append(' ');
+      out.append(code);
+      out.append(' ');
+      out.append(std::get<0>(*desc));
+      append_latencies(out, latencies, code);
+      out.append('\n');
+      append_top_keys(out, top, code, width);
+    }
+  }
+
+  bool heading = false;
+  for (unsigned int code = 0; code < counts.codes.size(); ++code) {
+    if (counts.codes[code] == 0) {
+      continue;
+    }
+    // Codes outside of the categories are listed here, with the description
+    // of a registry if it has one.
+    const auto desc = names.find(code);
+    if (desc.has_value() && code >= min_code && code <= max_code) {
+      continue;
+    }
+    if (!heading) {
+      out.append(unknown_heading);
+      heading = true;
+    }
+    out.append(counts.codes[code], width);
+    out.append(' ');
+    append_padded_code(out, code);
+    if (desc.has_value()) {
+      out.append(' ');
+      out.append(std::get<0>(*desc));
+    }
+    append_latencies(out, latencies, code);
+    out.append('\n');
+    append_top_keys(out, top, code, width);
+  }
+  if (counts.malformed != 0) {
+    if (!heading) {
+      out.append(unknown_heading);
+    }
+    out.append(counts.malformed, width);
+    out.append(" lines without a status code\n");
+  }
+}
+
+void append_sample_histogram(output_buffer& out, const sample_estimate& e,
+                             const registry& names) noexcept {
+  const stats::scoped_timer timer(stats::stage::render);
+  double max_count = 0;
+  double max_margin = 0;
+  const auto widen = [&](const sample_estimate::value& v) {
+    max_count = std::max(max_count, v.count);
+    max_margin = std::max(max_margin, v.count_margin);
+  };
+  for (std::size_t c = 0; c < std::size(categories); ++c) {
+    widen(e.category(c));
+  }
+  widen(e.malformed());
+  for (unsigned int code = 0; code < 1000; ++code) {
+    widen(e.code(code));
+  }
+  std::size_t width = 1;
+  for (auto n = static_cast<std::uint64_t>(std::llround(max_count)); n >= 10;
+       n /= 10) {
+    ++width;
+  }
+  std::size_t margin_width = 1;
+  for (auto n = static_cast<std::uint64_t>(std::llround(max_margin)); n >= 10;
+       n /= 10) {
+    ++margin_width;
+  }
+
+  for (std::size_t c = 0; c < std::size(categories); ++c) {
+    const category& cat = categories[c];
+    bool heading = false;
+    for (unsigned int code = cat.first_code; code <= cat.last_code; ++code) {
+      const auto desc = names.find(code);
+      if (!e.seen(code) || !desc.has_value()) {
+        continue;
+      }
+      if (!heading) {
+        out.append(cat.heading);
+        append_count_estimate(out, e.category(c), width, margin_width);
+        out.append("total");
+        append_share_estimate(out, e.category(c));
+        heading = true;
+      }
+      append_count_estimate(out, e.code(code), width, margin_width);
+      out.append(code);
+      out.append(' ');
+      out.append(std::get<0>(*desc));
+      append_share_estimate(out, e.code(code));
+    }
+  }
+
+  bool heading = false;
+  for (unsigned int code = 0; code < 1000; ++code) {
+    if (!e.seen(code)) {
+      continue;
+    }
+    const auto desc = names.find(code);
+    if (desc.has_value() && code >= min_code && code <= max_code) {
+      continue;
+    }
+    if (!heading) {
+      out.append(unknown_heading);
+      heading = true;
+    }
+    append_count_estimate(out, e.code(code), width, margin_width);
+    append_padded_code(out, code);
+    if (desc.has_value()) {
+      out.append(' ');
+      out.append(std::get<0>(*desc));
+    }
+    append_share_estimate(out, e.code(code));
+  }
+  if (e.seen_malformed()) {
+    if (!heading) {
+      out.append(unknown_heading);
+    }
+    append_count_estimate(out, e.malformed(), width, margin_width);
+    out.append("lines without a status code");
+    append_share_estimate(out, e.malformed());
+  }
+
+  out.append("\nEstimated from ");
+  out.append(e.blocks);
+  out.append(" of ");
+  out.append(e.total_blocks);
+  out.append(" blocks (");
+  append_percent(out, e.total_bytes != 0
+                          ? static_cast<double>(e.bytes_read) /
+                                static_cast<double>(e.total_bytes)
+                          : 0);
+  out.append(" of ");
+  out.append(e.total_bytes);
+  out.append(" bytes); \u00b1 bounds are 95% confidence intervals.\n");
+}
+
+}  // namespace httpcode
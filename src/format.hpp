@@ -0,0 +1,92 @@
+#ifndef HTTPCODE_FORMAT_HPP_
+#define HTTPCODE_FORMAT_HPP_
+
+#include <exception>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tl/expected.hpp>
+
+#include "code_set.hpp"
+#include "httpcode/codes.hpp"
+#include "latency.hpp"
+#include "log_sample.hpp"
+#include "log_scan.hpp"
+#include "output_buffer.hpp"
+#include "registry.hpp"
+#include "top_keys.hpp"
+
+namespace httpcode {
+
+/// Messages
+
+inline constexpr std::string_view invalid_code =
+    "Error: Invalid HTTP status code.\n";
+
+inline constexpr std::string_view invalid_category =
+    "Error: Invalid HTTP status category name. Valid names are informational, "
+    "success, redirection, client-error, and server-error.\n";
+
+inline constexpr std::string_view other_heading =
+    "-----\n"
+    "Other\n"
+    "-----\n";
+
+inline constexpr std::string_view unknown_heading =
+    "-------\n"
+    "Unknown\n"
+    "-------\n";
+
+/// Utility functions
+
+tl::expected<int, std::errc> to_digit(std::string_view s) noexcept;
+
+std::string format_output(unsigned int code, std::string_view short_desc,
+                          std::string_view long_desc,
+                          std::string_view learn_more_url) noexcept;
+
+// Same layout as `format_output`, rendered into a reusable buffer.
+void append_output(output_buffer& out, unsigned int code,
+                   const description& desc) noexcept;
+
+// Both list views are pre-rendered, see rendered.hpp.
+std::string_view list_all_codes() noexcept;
+
+tl::expected<std::string_view, std::exception> list_all_codes_for_category(
+    std::string_view category) noexcept;
+
+// Same as `list_all_codes` and `list_all_codes_for_category`, rendered at run
+// time with the codes of `names`.
+void append_list(output_buffer& out, const registry& names) noexcept;
+
+void append_category_list(output_buffer& out, const registry& names,
+                          const category& c) noexcept;
+
+// Lists the codes of `names` in `selected` in the same layout, under the
+// heading of each category that has any.
+void append_query_list(output_buffer& out, const registry& names,
+                       const code_set& selected) noexcept;
+
+// Appends the status code counters grouped under the same headings as
+// `list_all_codes_for_category`. Codes that are not in `names` and lines
+// without a status field are listed separately at the end. With `latencies`,
+// every code that has request times is followed by their `latency_quantiles`,
+// and with `top`, by its top keys on lines of their own, with the error bound
+// of each count after a ±.
+void append_histogram(output_buffer& out, const status_counts& counts,
+                      const registry& names,
+                      const latency_counts* latencies = nullptr,
+                      const top_keys* top = nullptr) noexcept;
+
+// Appends the estimates of a sample in the layout of `append_histogram`, with
+// the number of lines and the share of all lines of every code and category,
+// each followed by the half-width of its 95% confidence interval after a ±.
+void append_sample_histogram(output_buffer& out, const sample_estimate& e,
+                             const registry& names) noexcept;
+
+// Appends a duration in microseconds as "850us", "12.3ms" or "1.25s".
+void append_duration(output_buffer& out, std::uint64_t micros) noexcept;
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_FORMAT_HPP_
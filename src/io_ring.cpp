@@ -0,0 +1,187 @@
+#include "io_ring.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include "stats.hpp"
+
+namespace httpcode {
+
+namespace {
+
+std::error_code last_error() noexcept {
+  return std::error_code(errno, std::generic_category());
+}
+
+template <typename T>
+T* at(void* base, std::uint32_t offset) noexcept {
+  return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+}  // namespace
+
+io_ring::io_ring(io_ring&& other) noexcept { *this = std::move(other); }
+
+io_ring& io_ring::operator=(io_ring&& other) noexcept {
+  std::swap(fd_, other.fd_);
+  std::swap(sq_ring_, other.sq_ring_);
+  std::swap(cq_ring_, other.cq_ring_);
+  std::swap(sq_ring_size_, other.sq_ring_size_);
+  std::swap(cq_ring_size_, other.cq_ring_size_);
+  std::swap(sqes_, other.sqes_);
+  std::swap(sqes_size_, other.sqes_size_);
+  std::swap(sq_head_, other.sq_head_);
+  std::swap(sq_tail_, other.sq_tail_);
+  std::swap(sq_mask_, other.sq_mask_);
+  std::swap(sq_entries_, other.sq_entries_);
+  std::swap(sq_array_, other.sq_array_);
+  std::swap(cq_head_, other.cq_head_);
+  std::swap(cq_tail_, other.cq_tail_);
+  std::swap(cq_mask_, other.cq_mask_);
+  std::swap(cqes_, other.cqes_);
+  std::swap(queued_, other.queued_);
+  return *this;
+}
+
+io_ring::~io_ring() {
+  if (sqes_ != nullptr) {
+    ::munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+    ::munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != nullptr) {
+    ::munmap(sq_ring_, sq_ring_size_);
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+tl::expected<io_ring, std::error_code> io_ring::create(
+    unsigned int entries) noexcept {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  io_ring ring;
+  ring.fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+  if (ring.fd_ < 0) {
+    return tl::make_unexpected(last_error());
+  }
+
+  ring.sq_ring_size_ =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  ring.cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    ring.sq_ring_size_ = ring.cq_ring_size_ =
+        std::max(ring.sq_ring_size_, ring.cq_ring_size_);
+  }
+  void* sq = ::mmap(nullptr, ring.sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring.fd_, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) {
+    return tl::make_unexpected(last_error());
+  }
+  ring.sq_ring_ = sq;
+  if (single_mmap) {
+    ring.cq_ring_ = sq;
+  } else {
+    void* cq = ::mmap(nullptr, ring.cq_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring.fd_, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) {
+      return tl::make_unexpected(last_error());
+    }
+    ring.cq_ring_ = cq;
+  }
+  ring.sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = ::mmap(nullptr, ring.sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring.fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return tl::make_unexpected(last_error());
+  }
+  ring.sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  ring.sq_head_ = at<unsigned int>(ring.sq_ring_, params.sq_off.head);
+  ring.sq_tail_ = at<unsigned int>(ring.sq_ring_, params.sq_off.tail);
+  ring.sq_mask_ = *at<unsigned int>(ring.sq_ring_, params.sq_off.ring_mask);
+  ring.sq_entries_ = params.sq_entries;
+  ring.sq_array_ = at<unsigned int>(ring.sq_ring_, params.sq_off.array);
+  ring.cq_head_ = at<unsigned int>(ring.cq_ring_, params.cq_off.head);
+  ring.cq_tail_ = at<unsigned int>(ring.cq_ring_, params.cq_off.tail);
+  ring.cq_mask_ = *at<unsigned int>(ring.cq_ring_, params.cq_off.ring_mask);
+  ring.cqes_ = at<io_uring_cqe>(ring.cq_ring_, params.cq_off.cqes);
+  return ring;
+}
+
+std::error_code io_ring::register_buffers(
+    std::span<const iovec> buffers) noexcept {
+  if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS,
+                buffers.data(), static_cast<unsigned int>(buffers.size())) <
+      0) {
+    return last_error();
+  }
+  return {};
+}
+
+bool io_ring::read(int fd, char* data, std::uint32_t size,
+                   std::uint64_t offset,
+                   std::optional<unsigned int> buffer_index,
+                   std::uint64_t user_data) noexcept {
+  const unsigned int tail = *sq_tail_;
+  const unsigned int head =
+      std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+  if (tail - head == sq_entries_) {
+    return false;
+  }
+  const unsigned int index = tail & sq_mask_;
+  io_uring_sqe& sqe = sqes_[index];
+  std::memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = buffer_index.has_value() ? IORING_OP_READ_FIXED : IORING_OP_READ;
+  sqe.fd = fd;
+  sqe.addr = reinterpret_cast<std::uint64_t>(data);
+  sqe.len = size;
+  sqe.off = offset;
+  sqe.buf_index = static_cast<std::uint16_t>(buffer_index.value_or(0));
+  sqe.user_data = user_data;
+  sq_array_[index] = index;
+  std::atomic_ref(*sq_tail_).store(tail + 1, std::memory_order_release);
+  ++queued_;
+  return true;
+}
+
+std::error_code io_ring::submit(unsigned int wait) noexcept {
+  for (;;) {
+    const long ret = ::syscall(__NR_io_uring_enter, fd_, queued_, wait,
+                               wait != 0 ? IORING_ENTER_GETEVENTS : 0,
+                               nullptr, 0);
+    stats::add(stats::counter::read_calls);
+    if (ret >= 0) {
+      queued_ -= static_cast<unsigned int>(ret);
+      return {};
+    }
+    if (errno != EINTR) {
+      return last_error();
+    }
+  }
+}
+
+std::optional<io_completion> io_ring::pop() noexcept {
+  const unsigned int head = *cq_head_;
+  if (head == std::atomic_ref(*cq_tail_).load(std::memory_order_acquire)) {
+    return std::nullopt;
+  }
+  const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+  const io_completion completion{cqe.user_data, cqe.res};
+  std::atomic_ref(*cq_head_).store(head + 1, std::memory_order_release);
+  return completion;
+}
+
+}  // namespace httpcode
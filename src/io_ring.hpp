@@ -0,0 +1,81 @@
+#ifndef HTTPCODE_IO_RING_HPP_
+#define HTTPCODE_IO_RING_HPP_
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <tl/expected.hpp>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace httpcode {
+
+struct io_completion {
+  std::uint64_t user_data;
+  // The number of bytes read, or a negated errno value.
+  int result;
+};
+
+// Minimal io_uring wrapper over the raw system calls, covering what the block
+// reader needs: reads into plain or registered buffers and their completions.
+// Only one thread may use a ring.
+class io_ring {
+ public:
+  io_ring() noexcept = default;
+  io_ring(const io_ring&) = delete;
+  io_ring& operator=(const io_ring&) = delete;
+  io_ring(io_ring&& other) noexcept;
+  io_ring& operator=(io_ring&& other) noexcept;
+  ~io_ring();
+
+  // Sets up a ring with room for `entries` submissions. Fails where io_uring
+  // is not available, e.g. on old kernels or under seccomp filters.
+  static tl::expected<io_ring, std::error_code> create(
+      unsigned int entries) noexcept;
+
+  // Registers `buffers` for reads by index. Fails if they exceed the locked
+  // memory limit.
+  std::error_code register_buffers(std::span<const iovec> buffers) noexcept;
+
+  // Queues a read of `size` bytes at `offset` of `fd`, into registered buffer
+  // `buffer_index` if it is set. Returns false if the submission queue is
+  // full.
+  bool read(int fd, char* data, std::uint32_t size, std::uint64_t offset,
+            std::optional<unsigned int> buffer_index,
+            std::uint64_t user_data) noexcept;
+
+  // Submits the queued reads and waits until at least `wait` have completed.
+  std::error_code submit(unsigned int wait) noexcept;
+
+  // Returns the next completion, if there is one.
+  std::optional<io_completion> pop() noexcept;
+
+ private:
+  int fd_ = -1;
+  void* sq_ring_ = nullptr;
+  void* cq_ring_ = nullptr;
+  std::size_t sq_ring_size_ = 0;
+  std::size_t cq_ring_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  std::size_t sqes_size_ = 0;
+
+  unsigned int* sq_head_ = nullptr;
+  unsigned int* sq_tail_ = nullptr;
+  unsigned int sq_mask_ = 0;
+  unsigned int sq_entries_ = 0;
+  unsigned int* sq_array_ = nullptr;
+  unsigned int* cq_head_ = nullptr;
+  unsigned int* cq_tail_ = nullptr;
+  unsigned int cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  unsigned int queued_ = 0;
+};
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_IO_RING_HPP_
@@ -0,0 +1,72 @@
+#include "latency.hpp"
+
+#include <cmath>
+
+namespace httpcode {
+
+std::uint64_t latency_histogram::quantile(double q) const noexcept {
+  if (count_ == 0) {
+    return 0;
+  }
+  const auto rank = std::max<std::uint64_t>(
+      static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(count_))),
+      1);
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < bucket_count; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      return latency_bucket_limit(i);
+    }
+  }
+  return max_latency;
+}
+
+latency_counts& latency_counts::operator+=(const latency_counts& other) {
+  for (std::size_t code = 0; code < codes.size(); ++code) {
+    if (other.codes[code] == nullptr) {
+      continue;
+    }
+    if (codes[code] == nullptr) {
+      codes[code] = std::make_unique<latency_histogram>(*other.codes[code]);
+    } else {
+      *codes[code] += *other.codes[code];
+    }
+  }
+  return *this;
+}
+
+namespace {
+
+constexpr bool is_digit(char c) noexcept {
+  return static_cast<unsigned char>(c - '0') < 10;
+}
+
+}  // namespace
+
+std::optional<std::uint64_t> parse_seconds(std::string_view s) noexcept {
+  std::size_t i = 0;
+  std::uint64_t seconds = 0;
+  for (; i < s.size() && is_digit(s[i]); ++i) {
+    if (i == 10) {
+      return max_latency;
+    }
+    seconds = seconds * 10 + static_cast<std::uint64_t>(s[i] - '0');
+  }
+  const bool whole = i > 0;
+  std::uint64_t micros = 0;
+  std::uint64_t scale = 100000;
+  if (i < s.size() && s[i] == '.') {
+    for (++i; i < s.size() && is_digit(s[i]); ++i) {
+      micros += static_cast<std::uint64_t>(s[i] - '0') * scale;
+      scale /= 10;
+    }
+    if (scale == 100000 && !whole) {
+      return std::nullopt;
+    }
+  } else if (!whole) {
+    return std::nullopt;
+  }
+  return seconds * 1000000 + micros;
+}
+
+}  // namespace httpcode
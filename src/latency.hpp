@@ -0,0 +1,121 @@
+#ifndef HTTPCODE_LATENCY_HPP_
+#define HTTPCODE_LATENCY_HPP_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace httpcode {
+
+/// Latency histograms
+//
+// Request times are recorded in microseconds into log-bucketed histograms in
+// the manner of HdrHistogram: every power of two is split into 32 linear
+// sub-buckets, so a bucket is never wider than 1/32 of its values. Values
+// above `max_latency` (about 71 minutes) are recorded as `max_latency`.
+//
+// Bucket `shift * 32 + mantissa` holds the values whose top six bits are
+// `mantissa` once shifted right by `shift`; values below 64 get a bucket each.
+
+inline constexpr unsigned int latency_sub_bucket_bits = 5;
+inline constexpr std::uint64_t max_latency = (std::uint64_t{1} << 32) - 1;
+
+constexpr std::size_t latency_bucket(std::uint64_t micros) noexcept {
+  micros = std::min(micros, max_latency);
+  const auto width = static_cast<unsigned int>(std::bit_width(micros));
+  const unsigned int shift = width > latency_sub_bucket_bits + 1
+                                 ? width - latency_sub_bucket_bits - 1
+                                 : 0;
+  return (std::size_t{shift} << latency_sub_bucket_bits) + (micros >> shift);
+}
+
+// Returns the highest value that falls into `bucket`.
+constexpr std::uint64_t latency_bucket_limit(std::size_t bucket) noexcept {
+  const std::size_t shift = bucket >> latency_sub_bucket_bits < 2
+                                ? 0
+                                : (bucket >> latency_sub_bucket_bits) - 1;
+  const std::uint64_t mantissa = bucket - (shift << latency_sub_bucket_bits);
+  return ((mantissa + 1) << shift) - 1;
+}
+
+static_assert(latency_bucket(63) == 63 && latency_bucket(64) == 64);
+static_assert(latency_bucket_limit(latency_bucket(1000)) >= 1000);
+static_assert(latency_bucket_limit(latency_bucket(1000)) < 1000 + 1000 / 32);
+static_assert(latency_bucket_limit(latency_bucket(max_latency)) ==
+              max_latency);
+
+class latency_histogram {
+ public:
+  static constexpr std::size_t bucket_count = latency_bucket(max_latency) + 1;
+
+  void record(std::uint64_t micros) noexcept {
+    ++buckets_[latency_bucket(micros)];
+    ++count_;
+  }
+
+  // Merging adds up the buckets, so it loses no accuracy.
+  latency_histogram& operator+=(const latency_histogram& other) noexcept {
+    add(other.buckets_, other.count_);
+    return *this;
+  }
+
+  // Adds buckets holding `count` values in all, such as those of a snapshot.
+  void add(std::span<const std::uint64_t, bucket_count> buckets,
+           std::uint64_t count) noexcept {
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+      buckets_[i] += buckets[i];
+    }
+    count_ += count;
+  }
+
+  std::uint64_t count() const noexcept { return count_; }
+
+  const std::array<std::uint64_t, bucket_count>& buckets() const noexcept {
+    return buckets_;
+  }
+
+  // Returns the value at quantile `q` in [0, 1], as the highest value of its
+  // bucket, or 0 if the histogram is empty.
+  std::uint64_t quantile(double q) const noexcept;
+
+ private:
+  std::array<std::uint64_t, bucket_count> buckets_{};
+  std::uint64_t count_ = 0;
+};
+
+// The quantiles printed for every code, and their names.
+inline constexpr std::array<double, 4> latency_quantiles = {0.5, 0.9, 0.99,
+                                                            0.999};
+inline constexpr std::array<std::string_view, 4> latency_quantile_names = {
+    "p50", "p90", "p99", "p999"};
+
+// One histogram per status code, allocated the first time the code is seen,
+// so that memory is bounded by the number of distinct codes.
+struct latency_counts {
+  std::array<std::unique_ptr<latency_histogram>, 1000> codes;
+
+  void record(unsigned int code, std::uint64_t micros) {
+    if (codes[code] == nullptr) {
+      codes[code] = std::make_unique<latency_histogram>();
+    }
+    codes[code]->record(micros);
+  }
+
+  latency_counts& operator+=(const latency_counts& other);
+};
+
+// Parses a request time in seconds with up to microsecond precision, as
+// nginx writes `$request_time` and `$upstream_response_time` (e.g. "0.123").
+// Anything after the number, such as the rest of a list of upstream times, is
+// ignored. Returns nothing for "-" and other non-numbers.
+std::optional<std::uint64_t> parse_seconds(std::string_view s) noexcept;
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_LATENCY_HPP_
@@ -0,0 +1,235 @@
+#include "log_analysis.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "compressed_log.hpp"
+#include "mapped_file.hpp"
+#include "stats.hpp"
+#include "work_queue.hpp"
+
+namespace httpcode {
+
+namespace {
+
+std::runtime_error file_error(const char* path, std::string_view action,
+                              std::string_view reason) {
+  std::string what = "Cannot ";
+  what += action;
+  what += " '";
+  what += path;
+  what += "': ";
+  what += reason;
+  return std::runtime_error(what);
+}
+
+// Recognizes a compressed file by its first bytes, without mapping it. The
+// bytes could not be put back into a pipe, so only regular files are read.
+tl::expected<compression, std::error_code> read_compression(const char* path) {
+  const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return tl::make_unexpected(std::error_code(errno, std::generic_category()));
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    const int err = errno;
+    ::close(fd);
+    return tl::make_unexpected(std::error_code(err, std::generic_category()));
+  }
+  if (!S_ISREG(st.st_mode)) {
+    ::close(fd);
+    return tl::make_unexpected(not_regular_file());
+  }
+  char magic[4];
+  const ssize_t n = ::read(fd, magic, sizeof(magic));
+  const int err = errno;
+  ::close(fd);
+  if (n < 0) {
+    return tl::make_unexpected(std::error_code(err, std::generic_category()));
+  }
+  return detect_compression({magic, static_cast<std::size_t>(n)});
+}
+
+}  // namespace
+
+void log_analysis::scan(std::string_view data,
+                        const analysis_options& options) {
+  const stats::scoped_timer timer(stats::stage::scan);
+  if (options.latency_field == 0 && !options.top_by.has_value()) {
+    scan_log(data, counts);
+    return;
+  }
+  if (options.top_by.has_value() && !top.has_value()) {
+    top.emplace(*options.top_by, options.top_k, options.upstream_field);
+  }
+
+  // Anything beyond the status field needs each line on its own.
+  while (!data.empty()) {
+    const void* nl = std::memchr(data.data(), '\n', data.size());
+    const std::size_t end =
+        nl != nullptr ? static_cast<const char*>(nl) - data.data()
+                      : data.size();
+    const std::string_view line = data.substr(0, end);
+    data.remove_prefix(nl != nullptr ? end + 1 : end);
+    if (line.empty()) {
+      continue;
+    }
+
+    const auto code = find_status(line);
+    if (!code.has_value()) {
+      ++counts.malformed;
+      continue;
+    }
+    ++counts.codes[*code];
+    if (options.only != nullptr && !options.only->contains(*code)) {
+      continue;
+    }
+    if (options.latency_field != 0) {
+      const auto value = find_field(line, options.latency_field);
+      const auto micros =
+          value.has_value() ? parse_seconds(*value) : std::nullopt;
+      if (micros.has_value()) {
+        latencies.record(*code, *micros);
+      }
+    }
+    if (top.has_value()) {
+      top->record(*code, line);
+    }
+  }
+}
+
+log_analysis& log_analysis::operator+=(const log_analysis& other) {
+  counts += other.counts;
+  latencies += other.latencies;
+  if (other.top.has_value()) {
+    if (!top.has_value()) {
+      top.emplace(other.top->empty_copy());
+    }
+    *top += *other.top;
+  }
+  return *this;
+}
+
+void log_analysis::keep_only(const code_set& codes) noexcept {
+  for (unsigned int code = 0; code < counts.codes.size(); ++code) {
+    if (!codes.contains(code)) {
+      counts.codes[code] = 0;
+      latencies.codes[code].reset();
+    }
+  }
+  counts.malformed = 0;
+}
+
+tl::expected<log_analysis, std::runtime_error> analyze_logs(
+    std::span<const char* const> paths, const analysis_options& options) {
+  const unsigned int threads = std::max(options.threads, 1u);
+
+  // Indexed like `paths`, with nothing mapped for the files streamed instead.
+  std::vector<mapped_file> files(paths.size());
+  std::vector<std::string_view> plain;
+  std::vector<std::size_t> compressed;
+  std::vector<const char*> streamed;
+  std::size_t plain_size = 0;
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    if (options.io != io_backend::mmap) {
+      const auto kind = read_compression(paths[i]);
+      if (!kind.has_value()) {
+        return tl::make_unexpected(
+            file_error(paths[i], "read", kind.error().message()));
+      }
+      if (*kind == compression::none) {
+        streamed.push_back(paths[i]);
+        continue;
+      }
+    }
+    auto file = mapped_file::open(paths[i]);
+    if (!file.has_value()) {
+      return tl::make_unexpected(
+          file_error(paths[i], "read", file.error().message()));
+    }
+    if (detect_compression(file->view()) == compression::none) {
+      plain.push_back(file->view());
+      plain_size += file->view().size();
+    } else {
+      compressed.push_back(i);
+    }
+    files[i] = std::move(*file);
+  }
+
+  // Several chunks per worker so that stealing can even out skew, without
+  // making chunks so small that the per-chunk overhead shows.
+  const std::size_t chunk_size =
+      std::clamp<std::size_t>(plain_size / (threads * 8), 1 << 20, 64 << 20);
+  std::vector<std::string_view> chunks;
+  for (const std::string_view input : plain) {
+    split_lines(input, chunk_size, chunks);
+  }
+
+  // The last one is for the lines that `read_lines` scans itself.
+  std::vector<log_analysis> partial(threads + 1);
+  run_work_stealing(static_cast<std::uint32_t>(chunks.size()), threads,
+                    [&](unsigned int worker, std::uint32_t chunk) {
+                      partial[worker].scan(chunks[chunk], options);
+                    });
+
+  // Every worker keeps a decompress and a scan thread busy.
+  std::vector<std::optional<std::runtime_error>> errors(compressed.size());
+  if (!compressed.empty()) {
+    const unsigned int workers = static_cast<unsigned int>(
+        std::clamp<std::size_t>(threads / 2, 1, compressed.size()));
+    run_work_stealing(
+        static_cast<std::uint32_t>(compressed.size()), workers,
+        [&](unsigned int worker, std::uint32_t item) {
+          const std::string_view data = files[compressed[item]].view();
+          const auto result = decompress_lines(
+              data, detect_compression(data), [&](std::string_view lines) {
+                partial[worker].scan(lines, options);
+              });
+          if (!result.has_value()) {
+            errors[item] = result.error();
+          }
+        });
+  }
+  for (std::size_t item = 0; item < compressed.size(); ++item) {
+    if (errors[item].has_value()) {
+      return tl::make_unexpected(file_error(
+          paths[compressed[item]], "decompress", errors[item]->what()));
+    }
+  }
+
+  if (!streamed.empty()) {
+    block_read_options read_options;
+    read_options.backend = options.io;
+    read_options.threads = threads;
+    read_options.direct = options.direct;
+    const auto result = read_lines(
+        streamed, read_options, [&](unsigned int worker, std::string_view lines) {
+          partial[worker].scan(lines, options);
+        });
+    if (!result.has_value()) {
+      return tl::make_unexpected(result.error());
+    }
+  }
+
+  {
+    const stats::scoped_timer timer(stats::stage::merge);
+    for (unsigned int w = 1; w <= threads; ++w) {
+      partial[0] += partial[w];
+    }
+  }
+  std::uint64_t lines = partial[0].counts.malformed;
+  for (const std::uint64_t count : partial[0].counts.codes) lines += count;
+  stats::add(stats::counter::lines, lines);
+  return std::move(partial[0]);
+}
+
+}  // namespace httpcode
@@ -0,0 +1,73 @@
+#ifndef HTTPCODE_LOG_ANALYSIS_HPP_
+#define HTTPCODE_LOG_ANALYSIS_HPP_
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <tl/expected.hpp>
+
+#include "block_reader.hpp"
+#include "code_set.hpp"
+#include "latency.hpp"
+#include "log_scan.hpp"
+#include "top_keys.hpp"
+
+namespace httpcode {
+
+/// Log analysis
+
+struct analysis_options {
+  unsigned int threads = 1;
+  // Field holding the request time, numbered as by `find_field`, or 0 to
+  // count status codes only.
+  int latency_field = 0;
+  // Key to attribute codes to, if any, how many keys to report per code, and
+  // the field holding the upstream address.
+  std::optional<top_key> top_by;
+  std::size_t top_k = 10;
+  int upstream_field = 0;
+  // How plain files are read, and whether `read` and `uring` bypass the page
+  // cache.
+  io_backend io = io_backend::mmap;
+  bool direct = false;
+  // Codes whose request times and keys are recorded, or all of them if unset.
+  // The others share the sketches' slots otherwise, which `keep_only` cannot
+  // undo.
+  const code_set* only = nullptr;
+};
+
+// Everything collected from a set of access logs. Each worker fills its own
+// and the results are merged with `+=`, which loses nothing.
+struct log_analysis {
+  status_counts counts;
+  latency_counts latencies;
+  // Set if `top_by` is.
+  std::optional<top_keys> top;
+
+  // Adds the newline-aligned lines in `data`.
+  void scan(std::string_view data, const analysis_options& options);
+
+  log_analysis& operator+=(const log_analysis& other);
+
+  // Drops the counts and request times of the codes outside `codes` and the
+  // lines without a status field. Top keys must be limited while scanning,
+  // with `analysis_options::only`.
+  void keep_only(const code_set& codes) noexcept;
+};
+
+// Maps the access logs at `paths` and analyzes them with `options.threads`
+// workers. Plain files are split into newline-aligned chunks, several per
+// worker, which the workers take from their own queue first and then steal
+// from each other, each counting into its own `log_analysis` until they are
+// merged at the end; or they are streamed through `read_lines` with the
+// `read` and `uring` backends. Gzip and zstd files are decompressed on the way, each by a
+// worker that runs a decompress and a scan thread, as many at a time as the
+// thread count allows. Errors name the file they concern.
+tl::expected<log_analysis, std::runtime_error> analyze_logs(
+    std::span<const char* const> paths, const analysis_options& options);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_LOG_ANALYSIS_HPP_
@@ -0,0 +1,420 @@
+#include "log_grep.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "compressed_log.hpp"
+#include "log_scan.hpp"
+#include "mapped_file.hpp"
+#include "output_buffer.hpp"
+#include "stats.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTPCODE_X86 1
+#endif
+
+namespace httpcode {
+
+namespace {
+
+// As in `scan_log`, candidates are found 64 bytes at a time, looking two bytes
+// past the end of each block.
+constexpr std::size_t block_size = 64;
+constexpr std::size_t block_lookahead = 2;
+
+// First digits of the selected codes, as the range [lo, lo + span].
+struct digit_range {
+  unsigned char lo;
+  unsigned char span;
+};
+
+std::runtime_error grep_error(const char* path, std::string_view action,
+                              std::string_view reason) {
+  std::string what = "Cannot ";
+  what += action;
+  what += " '";
+  what += path;
+  what += "': ";
+  what += reason;
+  return std::runtime_error(what);
+}
+
+// Marks every `" d` at [i, i + n) whose digit is in `r`, reading at most up to
+// `size`.
+std::uint64_t candidates_scalar(const char* data, std::size_t size,
+                                std::size_t i, std::size_t n,
+                                digit_range r) noexcept {
+  std::uint64_t candidates = 0;
+  for (std::size_t k = 0; k < n; ++k) {
+    const std::size_t pos = i + k;
+    if (data[pos] == '"' && pos + 2 < size && data[pos + 1] == ' ' &&
+        static_cast<unsigned char>(data[pos + 2] - '0' - r.lo) <= r.span) {
+      candidates |= std::uint64_t{1} << k;
+    }
+  }
+  return candidates;
+}
+
+#ifdef HTTPCODE_X86
+
+std::uint64_t candidates_sse2(const char* p, digit_range r) noexcept {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i lo = _mm_set1_epi8(static_cast<char>('0' + r.lo));
+  const __m128i span = _mm_set1_epi8(static_cast<char>(r.span));
+  std::uint64_t candidates = 0;
+  for (int k = 0; k < 4; ++k) {
+    const char* q = p + k * 16;
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q));
+    const __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + 1));
+    const __m128i c =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + 2));
+    const __m128i digit_value = _mm_sub_epi8(c, lo);
+    const __m128i digit =
+        _mm_cmpeq_epi8(_mm_min_epu8(digit_value, span), digit_value);
+    const __m128i match = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(a, quote), _mm_cmpeq_epi8(b, space)),
+        digit);
+    candidates |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(
+                      _mm_movemask_epi8(match)))
+                  << (k * 16);
+  }
+  return candidates;
+}
+
+__attribute__((target("avx2"))) std::uint64_t candidates_avx2(
+    const char* p, digit_range r) noexcept {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i lo = _mm256_set1_epi8(static_cast<char>('0' + r.lo));
+  const __m256i span = _mm256_set1_epi8(static_cast<char>(r.span));
+  std::uint64_t candidates = 0;
+  for (int k = 0; k < 2; ++k) {
+    const char* q = p + k * 32;
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q));
+    const __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + 1));
+    const __m256i c =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + 2));
+    const __m256i digit_value = _mm256_sub_epi8(c, lo);
+    const __m256i digit =
+        _mm256_cmpeq_epi8(_mm256_min_epu8(digit_value, span), digit_value);
+    const __m256i match = _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi8(a, quote),
+                         _mm256_cmpeq_epi8(b, space)),
+        digit);
+    candidates |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(
+                      _mm256_movemask_epi8(match)))
+                  << (k * 32);
+  }
+  return candidates;
+}
+
+#endif  // HTTPCODE_X86
+
+// Calls `fn(begin, end)` with the bounds of every line of `data` whose status
+// is in `codes`, in order, where `end` is just past the newline if there is
+// one. Lines without a candidate for `r` are never looked at.
+template <typename Fn>
+void for_each_match(std::string_view data, const code_set& codes,
+                    digit_range r, Fn&& fn) {
+  using block_fn = std::uint64_t (*)(const char*, digit_range);
+  block_fn block = nullptr;
+#ifdef HTTPCODE_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  block = has_avx2 ? candidates_avx2 : candidates_sse2;
+#endif
+
+  const char* p = data.data();
+  const std::size_t size = data.size();
+  // Everything before `resume` belongs to lines that have been checked.
+  std::size_t resume = 0;
+  for (std::size_t i = 0; i < size;) {
+    const std::size_t n = std::min(block_size, size - i);
+    std::uint64_t candidates =
+        block != nullptr && i + block_size + block_lookahead <= size
+            ? block(p + i, r)
+            : candidates_scalar(p, size, i, n, r);
+    if (resume > i) {
+      candidates &= resume - i >= block_size ? 0 : ~std::uint64_t{0}
+                                                       << (resume - i);
+    }
+    while (candidates != 0) {
+      const std::size_t pos = i + std::countr_zero(candidates);
+      const void* start = ::memrchr(p + resume, '\n', pos - resume);
+      const std::size_t begin =
+          start != nullptr ? static_cast<const char*>(start) - p + 1 : resume;
+      const void* nl = std::memchr(p + pos, '\n', size - pos);
+      const std::size_t end =
+          nl != nullptr ? static_cast<const char*>(nl) - p + 1 : size;
+      // The candidate may not be the line's status field, which comes first.
+      const std::size_t line_end = nl != nullptr ? end - 1 : end;
+      const auto code = find_status(data.substr(begin, line_end - begin));
+      if (code.has_value() && codes.contains(*code)) {
+        fn(begin, end);
+      }
+      resume = end;
+      candidates &= resume - i >= block_size ? 0 : ~std::uint64_t{0}
+                                                       << (resume - i);
+    }
+    i = std::max(i + n, resume);
+  }
+}
+
+std::uint64_t count_lines(std::string_view data) noexcept {
+  const auto newlines =
+      static_cast<std::uint64_t>(std::count(data.begin(), data.end(), '\n'));
+  return newlines + (!data.empty() && data.back() != '\n' ? 1 : 0);
+}
+
+// Prints runs of selected lines of one file after another, along with their
+// context. A file may come in several pieces, each made of whole lines; the
+// lines that the next piece may need as context are held back by `finish`.
+class line_printer {
+ public:
+  line_printer(const grep_options& options, slice_writer& out,
+               bool prefix) noexcept
+      : options_(options), out_(out), prefix_(prefix) {}
+
+  void start(const char* path) noexcept {
+    path_ = path;
+    after_left_ = 0;
+    file_started_ = false;
+    detached_ = false;
+  }
+
+  // Continues the file with `data`, which starts with the lines held back
+  // from the previous piece, if any.
+  void next(std::string_view data) noexcept {
+    data_ = data;
+    printed_ = 0;
+    after_end_ = forward(0, after_left_, after_left_);
+  }
+
+  // Prints the whole lines in [begin, end), which are selected.
+  void select(std::size_t begin, std::size_t end) noexcept {
+    if (options_.before != 0 || options_.after != 0) {
+      if (file_started_ && !detached_ && begin <= after_end_) {
+        print(printed_, begin, '-');
+      } else {
+        print(printed_, after_end_, '-');
+        const std::size_t first = back(begin, options_.before, after_end_);
+        if (printed_any_ &&
+            (first > after_end_ || detached_ || !file_started_)) {
+          out_.add("--\n");
+        }
+        print(first, begin, '-');
+      }
+    }
+    print(begin, end, ':');
+    printed_ = end;
+    after_end_ = forward(end, options_.after, after_left_);
+  }
+
+  // Prints the context that follows the last selected lines of the piece.
+  // Returns where the lines start that the next piece may need as context
+  // before its first selected line.
+  std::size_t finish() noexcept {
+    print(printed_, after_end_, '-');
+    printed_ = after_end_;
+    if (after_left_ != 0) {
+      return data_.size();
+    }
+    const std::size_t held = back(data_.size(), options_.before, after_end_);
+    if (held > after_end_) {
+      detached_ = true;
+    }
+    return held;
+  }
+
+ private:
+  // Returns the start of the line `n` lines before the one at `pos`, or
+  // `floor` if that is further back.
+  std::size_t back(std::size_t pos, std::size_t n,
+                   std::size_t floor) const noexcept {
+    for (; n != 0 && pos > floor; --n) {
+      const void* nl = ::memrchr(data_.data() + floor, '\n', pos - 1 - floor);
+      pos = nl != nullptr ? static_cast<const char*>(nl) - data_.data() + 1
+                          : floor;
+    }
+    return pos;
+  }
+
+  // Returns the end of the line `n` lines after the one ending at `pos`, and
+  // in `left` how many of them lie past the end of the piece.
+  std::size_t forward(std::size_t pos, std::size_t n,
+                      std::size_t& left) const noexcept {
+    for (; n != 0 && pos < data_.size(); --n) {
+      const void* nl =
+          std::memchr(data_.data() + pos, '\n', data_.size() - pos);
+      pos = nl != nullptr ? static_cast<const char*>(nl) - data_.data() + 1
+                          : data_.size();
+    }
+    left = n;
+    return pos;
+  }
+
+  void print(std::size_t begin, std::size_t end, char separator) noexcept {
+    if (begin >= end) {
+      return;
+    }
+    printed_any_ = true;
+    file_started_ = true;
+    detached_ = false;
+    if (!prefix_) {
+      out_.add(data_.substr(begin, end - begin));
+    } else {
+      // Every line needs the path in front of it.
+      while (begin < end) {
+        const void* nl =
+            std::memchr(data_.data() + begin, '\n', end - begin);
+        const std::size_t stop =
+            nl != nullptr ? static_cast<const char*>(nl) - data_.data() + 1
+                          : end;
+        out_.add(path_);
+        out_.add(separator == ':' ? ":" : "-");
+        out_.add(data_.substr(begin, stop - begin));
+        begin = stop;
+      }
+    }
+    if (data_[end - 1] != '\n') {
+      out_.add("\n");
+    }
+  }
+
+  const grep_options& options_;
+  slice_writer& out_;
+  bool prefix_;
+  std::string_view data_;
+  std::string_view path_;
+  // End of the lines printed so far in the piece, of the context that follows
+  // them, and the number of context lines still owed to the next piece.
+  std::size_t printed_ = 0;
+  std::size_t after_end_ = 0;
+  std::size_t after_left_ = 0;
+  bool file_started_ = false;
+  // Whether lines before the piece were skipped, so that its first lines
+  // do not continue the output.
+  bool detached_ = false;
+  bool printed_any_ = false;
+};
+
+}  // namespace
+
+tl::expected<std::uint64_t, std::runtime_error> grep_logs(
+    std::span<const char* const> paths, const grep_options& options, int fd) {
+  digit_range range{9, 0};
+  unsigned int last = 0;
+  options.codes.for_each([&](unsigned int code) {
+    range.lo = std::min<unsigned char>(range.lo, code / 100);
+    last = code / 100;
+  });
+  range.span = static_cast<unsigned char>(last - range.lo);
+  const bool any = !options.codes.empty();
+
+  slice_writer out(fd);
+  output_buffer counts(fd);
+  line_printer printer(options, out, paths.size() > 1);
+  // Lines held back from the previous piece of a file, and those lines
+  // followed by the current piece.
+  std::string held;
+  std::string joined;
+  bool write_failed = false;
+  std::uint64_t total = 0;
+  for (const char* path : paths) {
+    auto file = mapped_file::open(path);
+    if (!file.has_value()) {
+      return tl::make_unexpected(
+          grep_error(path, "read", file.error().message()));
+    }
+
+    std::uint64_t matches = 0;
+    std::uint64_t lines = 0;
+    printer.start(path);
+    held.clear();
+    const auto grep_piece = [&](std::string_view piece) {
+      if (write_failed) {
+        return;
+      }
+      std::string_view data = piece;
+      if (!held.empty()) {
+        joined.assign(held);
+        joined.append(piece);
+        data = joined;
+      }
+      const std::size_t skip = held.size();
+      std::size_t gap = skip;
+      printer.next(data);
+      {
+        const stats::scoped_timer timer(stats::stage::scan);
+        if (any) {
+          for_each_match(data.substr(skip), options.codes, range,
+                         [&](std::size_t begin, std::size_t end) {
+                           ++matches;
+                           if (options.count) {
+                             return;
+                           }
+                           begin += skip;
+                           end += skip;
+                           if (!options.invert) {
+                             printer.select(begin, end);
+                           } else if (begin > gap) {
+                             printer.select(gap, begin);
+                           }
+                           gap = end;
+                         });
+        }
+        if (options.invert && !options.count && gap < data.size()) {
+          printer.select(gap, data.size());
+        }
+        if (options.invert) {
+          lines += count_lines(piece);
+        }
+      }
+      if (options.count) {
+        return;
+      }
+      const std::size_t keep = printer.finish();
+      // The slices point into the piece.
+      write_failed = !out.flush();
+      held.assign(data.substr(keep));
+    };
+
+    const std::string_view data = file->view();
+    if (const compression kind = detect_compression(data);
+        kind != compression::none) {
+      const auto result = decompress_lines(data, kind, grep_piece);
+      if (!result.has_value()) {
+        return tl::make_unexpected(
+            grep_error(path, "decompress", result.error().what()));
+      }
+    } else {
+      grep_piece(data);
+    }
+    if (write_failed) {
+      return tl::make_unexpected(std::runtime_error("Cannot write output."));
+    }
+
+    const std::uint64_t selected = options.invert ? lines - matches : matches;
+    total += selected;
+    if (options.count) {
+      if (paths.size() > 1) {
+        counts.append(path);
+        counts.append(':');
+      }
+      counts.append(selected);
+      counts.append('\n');
+    }
+  }
+  if (!counts.flush()) {
+    return tl::make_unexpected(std::runtime_error("Cannot write output."));
+  }
+  return total;
+}
+
+}  // namespace httpcode
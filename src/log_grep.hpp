@@ -0,0 +1,45 @@
+#ifndef HTTPCODE_LOG_GREP_HPP_
+#define HTTPCODE_LOG_GREP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <tl/expected.hpp>
+
+#include "code_set.hpp"
+
+namespace httpcode {
+
+/// Line extraction
+//
+// `grep <query> <logfile>...` prints the access log lines whose status field
+// (found by the rule of `scan_log`) is in a code query. Rather than looking
+// at every line, a vectorized prefilter looks for `" d` sequences whose digit
+// can start a selected code, and only the lines holding one are checked in
+// full. Selected lines are written straight from the mapped input with
+// writev(2).
+
+struct grep_options {
+  code_set codes;
+  // Select the lines whose status is not in `codes`, or that have none.
+  bool invert = false;
+  // Print the number of selected lines instead of the lines.
+  bool count = false;
+  // Lines of context to print before and after every selected line.
+  std::size_t before = 0;
+  std::size_t after = 0;
+};
+
+// Writes the lines of the logs at `paths` selected by `options` to `fd`, as
+// grep(1) would: prefixed with the path if there are several, and with `--`
+// between groups of lines that are not adjacent when printing context.
+// Compressed logs are decompressed and searched a piece at a time, holding
+// back only the lines needed as context. Returns the number of selected
+// lines. Errors name the file they concern.
+tl::expected<std::uint64_t, std::runtime_error> grep_logs(
+    std::span<const char* const> paths, const grep_options& options, int fd);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_LOG_GREP_HPP_
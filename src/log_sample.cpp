@@ -0,0 +1,383 @@
+#include "log_sample.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "compressed_log.hpp"
+#include "mapped_file.hpp"
+#include "stats.hpp"
+#include "work_queue.hpp"
+
+namespace httpcode {
+
+namespace {
+
+// Two-sided 95% quantile of the normal distribution.
+constexpr double z_95 = 1.959964;
+
+// Lines that start in a block are read to their end, up to this far past it.
+// A longer line is cut short, which leaves its status field in all but
+// pathological cases.
+constexpr std::size_t line_overhang = 4 << 10;
+
+std::runtime_error sample_error(const char* path, std::string_view reason) {
+  std::string what = "Cannot sample '";
+  what += path;
+  what += "': ";
+  what += reason;
+  return std::runtime_error(what);
+}
+
+std::optional<std::size_t> category_index(unsigned int code) noexcept {
+  for (std::size_t c = 0; c < std::size(categories); ++c) {
+    if (code >= categories[c].first_code && code <= categories[c].last_code) {
+      return c;
+    }
+  }
+  return std::nullopt;
+}
+
+std::uint64_t splitmix64(std::uint64_t& state) noexcept {
+  std::uint64_t z = (state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+// A random permutation of [0, n) that takes no memory: a few rounds of
+// invertible mixing on the smallest power of two that holds n, repeated until
+// the result falls below n.
+class block_order {
+ public:
+  block_order(std::uint64_t n, std::uint64_t seed) noexcept : n_(n) {
+    while (bits_ < 64 && (std::uint64_t{1} << bits_) < n) ++bits_;
+    mask_ = bits_ == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << bits_) - 1;
+    shift_ = std::max(bits_ / 2, 1u);
+    for (std::uint64_t& key : keys_) key = splitmix64(seed);
+  }
+
+  std::uint64_t operator()(std::uint64_t i) const noexcept {
+    do {
+      i = mix(i);
+    } while (i >= n_);
+    return i;
+  }
+
+ private:
+  std::uint64_t mix(std::uint64_t x) const noexcept {
+    for (const std::uint64_t key : keys_) {
+      x = (x * (key | 1)) & mask_;
+      x ^= x >> shift_;
+      x = (x + (key >> 32)) & mask_;
+    }
+    return x;
+  }
+
+  std::uint64_t n_;
+  unsigned int bits_ = 1;
+  unsigned int shift_ = 1;
+  std::uint64_t mask_ = 1;
+  std::array<std::uint64_t, 4> keys_;
+};
+
+struct sampled_file {
+  const char* path;
+  int fd = -1;
+  std::uint64_t size = 0;
+};
+
+// Closes the files when sampling ends, however it ends.
+struct sampled_files {
+  std::vector<sampled_file> files;
+
+  ~sampled_files() {
+    for (const sampled_file& f : files) {
+      if (f.fd >= 0) ::close(f.fd);
+    }
+  }
+};
+
+// Reads up to `size` bytes at `offset`, fewer only at the end of the file.
+tl::expected<std::size_t, std::error_code> read_at(int fd, char* data,
+                                                   std::size_t size,
+                                                   std::uint64_t offset) {
+  const stats::scoped_timer timer(stats::stage::read);
+  std::size_t done = 0;
+  while (done < size) {
+    const ssize_t n = ::pread(fd, data + done, size - done,
+                              static_cast<off_t>(offset + done));
+    stats::add(stats::counter::read_calls);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return tl::make_unexpected(
+          std::error_code(errno, std::generic_category()));
+    }
+    if (n == 0) break;
+    done += static_cast<std::size_t>(n);
+  }
+  stats::add(stats::counter::bytes_read, done);
+  return done;
+}
+
+// Counts the lines that start in block `block` of `f` into `counts`, reading
+// into `buffer`. Returns the size of the block, without the bytes around it
+// that were read to find its lines.
+tl::expected<std::size_t, std::error_code> read_block(
+    const sampled_file& f, std::uint64_t block, std::size_t block_size,
+    char* buffer, status_counts& counts) {
+  // One byte before the block tells whether a line starts at its first byte.
+  const std::uint64_t begin = block * block_size;
+  const std::uint64_t from = begin == 0 ? 0 : begin - 1;
+  const std::size_t size = static_cast<std::size_t>(std::min<std::uint64_t>(
+      (begin - from) + block_size + line_overhang, f.size - from));
+  const auto n = read_at(f.fd, buffer, size, from);
+  if (!n.has_value()) {
+    return n;
+  }
+  const std::string_view data(buffer, *n);
+  const auto own_size = static_cast<std::size_t>(
+      std::min<std::uint64_t>(block_size, f.size - begin));
+
+  std::size_t start = 0;
+  if (begin != 0) {
+    const void* nl = std::memchr(data.data(), '\n', data.size());
+    start = nl != nullptr ? static_cast<const char*>(nl) - data.data() + 1
+                          : data.size();
+  }
+  const std::size_t limit = (begin - from) + block_size;
+  if (start >= limit || start >= data.size()) {
+    return own_size;
+  }
+  std::size_t end = data.size();
+  if (limit <= data.size()) {
+    const void* nl =
+        std::memchr(data.data() + limit - 1, '\n', data.size() - limit + 1);
+    if (nl != nullptr) {
+      end = static_cast<const char*>(nl) - data.data() + 1;
+    }
+  }
+  const stats::scoped_timer timer(stats::stage::scan);
+  scan_log(data.substr(start, end - start), counts);
+  return own_size;
+}
+
+}  // namespace
+
+void sample_estimate::add_block(const status_counts& block,
+                                const code_set* only) noexcept {
+  double x = static_cast<double>(block.malformed);
+  for (const std::uint64_t count : block.codes) {
+    x += static_cast<double>(count);
+  }
+  x_ += x;
+  xx_ += x * x;
+  ++blocks;
+
+  std::array<double, std::size(categories)> in_category{};
+  for (unsigned int code = 0; code < block.codes.size(); ++code) {
+    if (block.codes[code] == 0 ||
+        (only != nullptr && !only->contains(code))) {
+      continue;
+    }
+    const auto y = static_cast<double>(block.codes[code]);
+    codes_[code].add(y, x);
+    if (const auto c = category_index(code)) {
+      in_category[*c] += y;
+    }
+  }
+  for (std::size_t c = 0; c < in_category.size(); ++c) {
+    categories_[c].add(in_category[c], x);
+  }
+  if (only == nullptr) {
+    malformed_.add(static_cast<double>(block.malformed), x);
+  }
+}
+
+sample_estimate& sample_estimate::operator+=(
+    const sample_estimate& other) noexcept {
+  const auto add = [](sums& a, const sums& b) {
+    a.y += b.y;
+    a.yy += b.yy;
+    a.xy += b.xy;
+  };
+  for (std::size_t i = 0; i < codes_.size(); ++i) {
+    add(codes_[i], other.codes_[i]);
+  }
+  for (std::size_t c = 0; c < categories_.size(); ++c) {
+    add(categories_[c], other.categories_[c]);
+  }
+  add(malformed_, other.malformed_);
+  x_ += other.x_;
+  xx_ += other.xx_;
+  blocks += other.blocks;
+  bytes_read += other.bytes_read;
+  return *this;
+}
+
+sample_estimate::value sample_estimate::code(unsigned int code) const noexcept {
+  return estimate(codes_[code]);
+}
+
+sample_estimate::value sample_estimate::category(
+    std::size_t c) const noexcept {
+  return estimate(categories_[c]);
+}
+
+sample_estimate::value sample_estimate::malformed() const noexcept {
+  return estimate(malformed_);
+}
+
+sample_estimate::value sample_estimate::estimate(
+    const sums& s) const noexcept {
+  value v;
+  if (blocks == 0) {
+    return v;
+  }
+  const auto m = static_cast<double>(blocks);
+  const auto total = static_cast<double>(total_blocks);
+  v.count = total * s.y / m;
+  v.share = x_ > 0 ? s.y / x_ : 0;
+  // A census, however few blocks it takes, has nothing left to estimate.
+  if (blocks == total_blocks) {
+    v.count_margin = v.share_margin = 0;
+    return v;
+  }
+  if (blocks < 2) {
+    v.count_margin = v.share_margin = -1;
+    return v;
+  }
+  const double unsampled = std::max(0.0, 1 - m / total);
+
+  // Variance of the block totals for counts, and of the residuals of the
+  // ratio y / x for shares.
+  const double var_y = std::max(0.0, (s.yy - s.y * s.y / m) / (m - 1));
+  v.count_margin = z_95 * total * std::sqrt(unsampled * var_y / m);
+  const double var_r = std::max(
+      0.0, (s.yy - 2 * v.share * s.xy + v.share * v.share * xx_) / (m - 1));
+  const double mean_x = x_ / m;
+  v.share_margin =
+      mean_x > 0 ? z_95 * std::sqrt(unsampled * var_r / m) / mean_x : 0;
+  return v;
+}
+
+tl::expected<sample_estimate, std::runtime_error> sample_logs(
+    std::span<const char* const> paths, const sample_options& options) {
+  const unsigned int threads = std::max(options.threads, 1u);
+  const std::size_t block_size = std::max<std::size_t>(options.block_size, 1);
+
+  sampled_files open;
+  std::vector<std::uint64_t> first_block{0};
+  open.files.reserve(paths.size());
+  for (const char* path : paths) {
+    sampled_file& f = open.files.emplace_back();
+    f.path = path;
+    f.fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (f.fd < 0 || ::fstat(f.fd, &st) != 0) {
+      return tl::make_unexpected(
+          sample_error(path, std::generic_category().message(errno)));
+    }
+    // Blocks are picked by offset, which a pipe does not have.
+    if (!S_ISREG(st.st_mode)) {
+      return tl::make_unexpected(
+          sample_error(path, not_regular_file().message()));
+    }
+    f.size = static_cast<std::uint64_t>(st.st_size);
+    char magic[4];
+    const auto n = read_at(f.fd, magic, sizeof(magic), 0);
+    if (!n.has_value()) {
+      return tl::make_unexpected(sample_error(path, n.error().message()));
+    }
+    if (detect_compression({magic, *n}) != compression::none) {
+      return tl::make_unexpected(
+          sample_error(path, "compressed logs can only be read in full"));
+    }
+    // Readahead would read far more than the sampled blocks.
+    ::posix_fadvise(f.fd, 0, 0, POSIX_FADV_RANDOM);
+    first_block.push_back(first_block.back() +
+                          (f.size + block_size - 1) / block_size);
+  }
+
+  sample_estimate total;
+  total.total_blocks = first_block.back();
+  for (const sampled_file& f : open.files) {
+    total.total_bytes += f.size;
+  }
+  if (total.total_blocks == 0) {
+    return total;
+  }
+
+  // With a budget, blocks are read in the same random order until it runs
+  // out, but never fewer than two, which a confidence interval needs.
+  const bool budgeted = options.rate <= 0;
+  const std::uint64_t wanted =
+      budgeted ? total.total_blocks
+               : std::clamp<std::uint64_t>(
+                     static_cast<std::uint64_t>(std::ceil(
+                         options.rate * static_cast<double>(total.total_blocks))),
+                     1, total.total_blocks);
+  const auto deadline = std::chrono::steady_clock::now() + options.budget;
+  std::atomic<bool> stop = false;
+  std::atomic<std::uint64_t> started = 0;
+
+  const block_order order(total.total_blocks, options.seed);
+  std::vector<sample_estimate> partial(threads);
+  std::vector<std::unique_ptr<char[]>> buffers(threads);
+  std::vector<std::optional<std::runtime_error>> errors(threads);
+  run_work_stealing(
+      static_cast<std::uint32_t>(std::min<std::uint64_t>(wanted, UINT32_MAX)),
+      threads, [&](unsigned int worker, std::uint32_t item) {
+        if (stop.load(std::memory_order_relaxed)) {
+          return;
+        }
+        if (budgeted && started.fetch_add(1, std::memory_order_relaxed) >= 2 &&
+            std::chrono::steady_clock::now() >= deadline) {
+          stop.store(true, std::memory_order_relaxed);
+          return;
+        }
+        if (buffers[worker] == nullptr) {
+          buffers[worker] =
+              std::make_unique<char[]>(block_size + line_overhang + 1);
+        }
+
+        const std::uint64_t block = order(item);
+        const std::size_t file = static_cast<std::size_t>(
+            std::upper_bound(first_block.begin(), first_block.end(), block) -
+            first_block.begin() - 1);
+        status_counts counts;
+        const auto n =
+            read_block(open.files[file], block - first_block[file],
+                       block_size, buffers[worker].get(), counts);
+        if (!n.has_value()) {
+          errors[worker] =
+              sample_error(open.files[file].path, n.error().message());
+          stop.store(true, std::memory_order_relaxed);
+          return;
+        }
+        partial[worker].add_block(counts, options.only);
+        partial[worker].bytes_read += *n;
+      });
+
+  for (unsigned int w = 0; w < threads; ++w) {
+    if (errors[w].has_value()) {
+      return tl::make_unexpected(*errors[w]);
+    }
+    total += partial[w];
+  }
+  return total;
+}
+
+}  // namespace httpcode
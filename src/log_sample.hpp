@@ -0,0 +1,118 @@
+#ifndef HTTPCODE_LOG_SAMPLE_HPP_
+#define HTTPCODE_LOG_SAMPLE_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <tl/expected.hpp>
+
+#include "code_set.hpp"
+#include "httpcode/codes.hpp"
+#include "log_scan.hpp"
+
+namespace httpcode {
+
+/// Sampling
+//
+// `histogram --sample RATE` and `--budget SECONDS` estimate the histogram of
+// a log set from a random sample of its blocks instead of reading all of it.
+// The logs are divided into fixed-size blocks, which are visited in a random
+// order: a `RATE` fraction of them, or as many as fit in the time budget. A
+// block is re-aligned to the lines that start within it, so that every line
+// belongs to exactly one block and is sampled with the same probability
+// whatever its length.
+//
+// Lines in the same block are not independent (errors come in bursts), so
+// the blocks are treated as clusters of a simple random sample without
+// replacement. Counts are estimated as `blocks * mean per block` and shares
+// with the ratio estimator, each with the usual variance of a cluster sample
+// including the finite population correction.
+
+struct sample_options {
+  // Fraction of the blocks to read, in (0, 1], or 0 to read blocks until
+  // `budget` has passed.
+  double rate = 0;
+  std::chrono::nanoseconds budget{0};
+  unsigned int threads = 1;
+  std::size_t block_size = 64 << 10;
+  // Selects the blocks. Runs with the same seed read the same blocks.
+  std::uint64_t seed = 0x9e3779b97f4a7c15;
+  // Codes to estimate, or all of them if unset. The others only count as
+  // lines.
+  const code_set* only = nullptr;
+};
+
+// The sums over the sampled blocks from which the estimates follow.
+class sample_estimate {
+ public:
+  struct value {
+    // Estimated number of lines, and that of all lines that they make up,
+    // each with the half-width of its 95% confidence interval. Margins are
+    // negative while fewer than two blocks have been read, unless those are
+    // all the blocks there are.
+    double count = 0;
+    double count_margin = 0;
+    double share = 0;
+    double share_margin = 0;
+  };
+
+  // Adds the lines counted in one sampled block.
+  void add_block(const status_counts& block, const code_set* only) noexcept;
+
+  sample_estimate& operator+=(const sample_estimate& other) noexcept;
+
+  value code(unsigned int code) const noexcept;
+  value category(std::size_t c) const noexcept;
+  // Lines without a status field.
+  value malformed() const noexcept;
+
+  // Whether any sampled line has `code`.
+  bool seen(unsigned int code) const noexcept {
+    return codes_[code].y != 0;
+  }
+  bool seen_malformed() const noexcept { return malformed_.y != 0; }
+
+  std::uint64_t blocks = 0;
+  std::uint64_t total_blocks = 0;
+  // Bytes of the sampled blocks, not counting those read past their ends to
+  // find their lines, which only the stats counters include.
+  std::uint64_t bytes_read = 0;
+  std::uint64_t total_bytes = 0;
+
+ private:
+  // Sums of y, y^2 and x*y over the blocks, where y counts the lines of a
+  // code or category and x all lines of the block.
+  struct sums {
+    double y = 0;
+    double yy = 0;
+    double xy = 0;
+
+    void add(double block_y, double block_x) noexcept {
+      y += block_y;
+      yy += block_y * block_y;
+      xy += block_x * block_y;
+    }
+  };
+
+  value estimate(const sums& s) const noexcept;
+
+  std::array<sums, 1000> codes_;
+  std::array<sums, std::size(categories)> categories_;
+  sums malformed_;
+  double x_ = 0;
+  double xx_ = 0;
+};
+
+// Estimates the histogram of the access logs at `paths` from the sample
+// described by `options`, read with `options.threads` workers. Compressed
+// logs cannot be read at random and are refused. Errors name the file they
+// concern.
+tl::expected<sample_estimate, std::runtime_error> sample_logs(
+    std::span<const char* const> paths, const sample_options& options);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_LOG_SAMPLE_HPP_
@@ -0,0 +1,277 @@
+#include "log_scan.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTPCODE_X86 1
+#endif
+
+namespace httpcode {
+
+namespace {
+
+// Every vectorized scanner consumes 64-byte blocks and reads two bytes past the
+// end of each block, since a candidate is matched at offsets 0, 1 and 2.
+constexpr std::size_t block_size = 64;
+constexpr std::size_t block_lookahead = 2;
+
+struct scan_state {
+  std::size_t line_start = 0;
+  bool found = false;
+};
+
+constexpr bool is_digit(char c) noexcept {
+  return static_cast<unsigned char>(c - '0') < 10;
+}
+
+// Handles one block of input starting at `base`. A bit in `candidates` marks a
+// `" d` sequence (a possible status field) and a bit in `newlines` marks a
+// line break. Only the first valid candidate of each line is counted.
+inline void process_block(const char* data, std::size_t size,
+                          std::size_t base, std::uint64_t candidates,
+                          std::uint64_t newlines, scan_state& state,
+                          status_counts& counts) noexcept {
+  std::uint64_t bits = candidates | newlines;
+  while (bits != 0) {
+    if (state.found) {
+      // Skip the rest of the line once its status field has been counted.
+      const std::uint64_t remaining = bits & newlines;
+      if (remaining == 0) {
+        return;
+      }
+      bits &= ~((remaining & -remaining) - 1);
+    }
+
+    const int bit = std::countr_zero(bits);
+    const std::size_t pos = base + bit;
+    bits &= bits - 1;
+    if ((newlines >> bit) & 1) {
+      if (!state.found && pos > state.line_start) {
+        ++counts.malformed;
+      }
+      state.found = false;
+      state.line_start = pos + 1;
+    } else if (pos + 5 < size && is_digit(data[pos + 3]) &&
+               is_digit(data[pos + 4]) && data[pos + 5] == ' ') {
+      const unsigned int code = (data[pos + 2] - '0') * 100 +
+                                (data[pos + 3] - '0') * 10 +
+                                (data[pos + 4] - '0');
+      ++counts.codes[code];
+      state.found = true;
+    }
+  }
+}
+
+// Portable fallback, also used for the tail of every scan.
+std::size_t scan_scalar(const char* data, std::size_t size, std::size_t i,
+                        scan_state& state, status_counts& counts) noexcept {
+  for (; i < size; i += block_size) {
+    const std::size_t n = size - i < block_size ? size - i : block_size;
+    std::uint64_t candidates = 0;
+    std::uint64_t newlines = 0;
+    for (std::size_t k = 0; k < n; ++k) {
+      const std::size_t pos = i + k;
+      if (data[pos] == '\n') {
+        newlines |= std::uint64_t{1} << k;
+      } else if (data[pos] == '"' && pos + 2 < size && data[pos + 1] == ' ' &&
+                 is_digit(data[pos + 2])) {
+        candidates |= std::uint64_t{1} << k;
+      }
+    }
+    process_block(data, size, i, candidates, newlines, state, counts);
+  }
+  return i;
+}
+
+#ifdef HTTPCODE_X86
+
+std::size_t scan_sse2(const char* data, std::size_t size, std::size_t i,
+                      scan_state& state, status_counts& counts) noexcept {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i nine = _mm_set1_epi8(9);
+  for (; i + block_size + block_lookahead <= size; i += block_size) {
+    std::uint64_t candidates = 0;
+    std::uint64_t newlines = 0;
+    for (int k = 0; k < 4; ++k) {
+      const char* p = data + i + k * 16;
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      const __m128i b =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+      const __m128i c =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+      const __m128i digit_value = _mm_sub_epi8(c, zero);
+      const __m128i digit =
+          _mm_cmpeq_epi8(_mm_min_epu8(digit_value, nine), digit_value);
+      const __m128i match = _mm_and_si128(
+          _mm_and_si128(_mm_cmpeq_epi8(a, quote), _mm_cmpeq_epi8(b, space)),
+          digit);
+      candidates |=
+          static_cast<std::uint64_t>(
+              static_cast<std::uint16_t>(_mm_movemask_epi8(match)))
+          << (k * 16);
+      newlines |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(
+                      _mm_movemask_epi8(_mm_cmpeq_epi8(a, newline))))
+                  << (k * 16);
+    }
+    process_block(data, size, i, candidates, newlines, state, counts);
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) std::size_t scan_avx2(
+    const char* data, std::size_t size, std::size_t i, scan_state& state,
+    status_counts& counts) noexcept {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i newline = _mm256_set1_epi8('\n');
+  const __m256i zero = _mm256_set1_epi8('0');
+  const __m256i nine = _mm256_set1_epi8(9);
+  for (; i + block_size + block_lookahead <= size; i += block_size) {
+    std::uint64_t candidates = 0;
+    std::uint64_t newlines = 0;
+    for (int k = 0; k < 2; ++k) {
+      const char* p = data + i + k * 32;
+      const __m256i a =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+      const __m256i b =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+      const __m256i c =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 2));
+      const __m256i digit_value = _mm256_sub_epi8(c, zero);
+      const __m256i digit = _mm256_cmpeq_epi8(
+          _mm256_min_epu8(digit_value, nine), digit_value);
+      const __m256i match = _mm256_and_si256(
+          _mm256_and_si256(_mm256_cmpeq_epi8(a, quote),
+                           _mm256_cmpeq_epi8(b, space)),
+          digit);
+      candidates |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(
+                         _mm256_movemask_epi8(match)))
+                     << (k * 32);
+      newlines |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(
+                      _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, newline))))
+                  << (k * 32);
+    }
+    process_block(data, size, i, candidates, newlines, state, counts);
+  }
+  return i;
+}
+
+#endif  // HTTPCODE_X86
+
+// Calls `fn` with every field of `line` until it returns false.
+template <typename Fn>
+void for_each_field(std::string_view line, Fn&& fn) noexcept {
+  std::size_t i = 0;
+  while (i < line.size()) {
+    if (line[i] == ' ') {
+      ++i;
+      continue;
+    }
+    const char close = line[i] == '"' ? '"' : line[i] == '[' ? ']' : ' ';
+    const std::size_t end =
+        close == ' ' ? line.find(' ', i) : line.find(close, i + 1);
+    const std::size_t stop = end == std::string_view::npos ? line.size()
+                             : close == ' '                ? end
+                                                           : end + 1;
+    if (!fn(line.substr(i, stop - i))) {
+      return;
+    }
+    i = stop;
+  }
+}
+
+}  // namespace
+
+void scan_log(std::string_view data, status_counts& counts) noexcept {
+  scan_state state;
+  std::size_t i = 0;
+#ifdef HTTPCODE_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  i = has_avx2 ? scan_avx2(data.data(), data.size(), i, state, counts)
+               : scan_sse2(data.data(), data.size(), i, state, counts);
+#endif
+  scan_scalar(data.data(), data.size(), i, state, counts);
+  if (!state.found && data.size() > state.line_start) {
+    ++counts.malformed;
+  }
+}
+
+void split_lines(std::string_view data, std::size_t chunk_size,
+                 std::vector<std::string_view>& chunks) {
+  while (!data.empty()) {
+    std::size_t end = data.size();
+    if (chunk_size < data.size()) {
+      const void* nl = std::memchr(data.data() + chunk_size, '\n',
+                                   data.size() - chunk_size);
+      if (nl != nullptr) {
+        end = static_cast<const char*>(nl) - data.data() + 1;
+      }
+    }
+    chunks.push_back(data.substr(0, end));
+    data.remove_prefix(end);
+  }
+}
+
+std::optional<unsigned int> find_status(std::string_view line) noexcept {
+  for (std::size_t pos = line.find('"'); pos != std::string_view::npos;
+       pos = line.find('"', pos + 1)) {
+    if (pos + 5 < line.size() && line[pos + 1] == ' ' &&
+        is_digit(line[pos + 2]) && is_digit(line[pos + 3]) &&
+        is_digit(line[pos + 4]) && line[pos + 5] == ' ') {
+      return (line[pos + 2] - '0') * 100 + (line[pos + 3] - '0') * 10 +
+             (line[pos + 4] - '0');
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<std::string_view> find_field(std::string_view line,
+                                           int field) noexcept {
+  if (field < 0) {
+    // Walk back from the end, so that trailing fields cost as little as
+    // leading ones.
+    std::size_t end = line.size();
+    for (int index = -1;; --index) {
+      while (end > 0 && line[end - 1] == ' ') --end;
+      if (end == 0) {
+        return std::nullopt;
+      }
+      const char open = line[end - 1] == '"' ? '"'
+                        : line[end - 1] == ']' ? '['
+                                               : ' ';
+      std::size_t begin = end > 1 ? line.rfind(open, end - 2)
+                                  : std::string_view::npos;
+      if (begin == std::string_view::npos) {
+        begin = 0;
+      } else if (open == ' ') {
+        ++begin;
+      }
+      if (index == field) {
+        return line.substr(begin, end - begin);
+      }
+      end = begin;
+    }
+  }
+  if (field == 0) {
+    return std::nullopt;
+  }
+  std::optional<std::string_view> found;
+  int index = 0;
+  for_each_field(line, [&](std::string_view f) {
+    if (++index == field) {
+      found = f;
+      return false;
+    }
+    return true;
+  });
+  return found;
+}
+
+}  // namespace httpcode
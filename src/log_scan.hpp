@@ -0,0 +1,54 @@
+#ifndef HTTPCODE_LOG_SCAN_HPP_
+#define HTTPCODE_LOG_SCAN_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace httpcode {
+
+// Status code counters collected from access log lines. Aligned to a cache
+// line so that per-thread instances never share one.
+struct alignas(64) status_counts {
+  // Number of lines per status code, indexed by the three-digit code itself so
+  // that codes missing from the `codes` table are kept as well.
+  std::array<std::uint64_t, 1000> codes{};
+  // Non-empty lines in which no status field was found.
+  std::uint64_t malformed = 0;
+
+  status_counts& operator+=(const status_counts& other) noexcept {
+    for (std::size_t i = 0; i < codes.size(); ++i) {
+      codes[i] += other.codes[i];
+    }
+    malformed += other.malformed;
+    return *this;
+  }
+};
+
+// Finds the status field of every nginx/Apache combined-format line in `data`
+// and adds it to `counts`. The status field is the three digits following the
+// closing quote of the request line, i.e. the first `" ddd ` in each line.
+void scan_log(std::string_view data, status_counts& counts) noexcept;
+
+// Splits `data` into pieces of roughly `chunk_size` bytes that each end just
+// after a newline (or at the end of `data`), so that every line falls entirely
+// within one piece.
+void split_lines(std::string_view data, std::size_t chunk_size,
+                 std::vector<std::string_view>& chunks);
+
+// Returns the status field of a single line by the same rule as `scan_log`,
+// or nothing if it has none.
+std::optional<unsigned int> find_status(std::string_view line) noexcept;
+
+// Returns field `field` of an access log line. Fields are separated by spaces,
+// except that "quoted" and [bracketed] fields may contain spaces. Fields are
+// numbered from 1, and negative numbers count from the end of the line.
+std::optional<std::string_view> find_field(std::string_view line,
+                                           int field) noexcept;
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_LOG_SCAN_HPP_
@@ -1,527 +1,808 @@
-#include <exception>
-#include <iostream>
-#include <map>
-#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <tl/expected.hpp>
 
-namespace httpcode {
+#include "batch.hpp"
+#include "client.hpp"
+#include "code_set.hpp"
+#include "format.hpp"
+#include "httpcode/codes.hpp"
+#include "log_analysis.hpp"
+#include "log_grep.hpp"
+#include "log_sample.hpp"
+#include "mapped_file.hpp"
+#include "output_buffer.hpp"
+#include "registry.hpp"
+#include "rendered.hpp"
+#include "search.hpp"
+#include "serialize.hpp"
+#include "server.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
+#include "watch.hpp"
 
-/// List of HTTP status codes
-
-using description =
-    std::tuple<std::string_view, std::string_view, std::string_view>;
-
-// Map consisting of HTTP status codes and their respective descriptions. Each
-// description  contains a short description (e.g. 'OK'), a longer description
-// (e.g. 'The request has succeeded.'), and a URL to learn more about the given
-// HTTP status code (e.g. `https://httpstatuses.io/200`). Each entry in the map
-// has the following format: {code: (short_desc, long_desc, url)}
-static const std::map<unsigned int, description> codes = {
-    {100,
-     {"Continue",
-      "The initial part of a request has been received and has not yet "
-      "been rejected by the server. The server intends to send a final "
-      "response after the request has been fully received and acted "
-      "upon.",
-      "https://httpstatuses.io/100"}},
-    {101,
-     {"Switching Protocols",
-      "The server understands and is willing to comply with the client's "
-      "request, via the Upgrade header field, for a change in the "
-      "application protocol being used on this connection.",
-      "https://httpstatuses.io/101"}},
-    {102,
-     {"Processing",
-      "An interim response used to inform the client that the server has "
-      "accepted the complete request, but has not yet completed it.",
-      "https://httpstatuses.io/102"}},
-    {103,
-     {"Early Hints",
-      "This status code indicates to the client that the server is likely "
-      "to send a final response with the header fields included in the "
-      "informational response.",
-      "https://httpstatuses.io/103"}},
-    {200,
-     {"OK", "The request has succeeded.", "https://httpstatuses.io/200"}},
-    {201,
-     {"Created",
-      "The request has been fulfilled and has resulted in one or more new "
-      "resources being created.",
-      "https://httpstatuses.io/201"}},
-    {202,
-     {"Accepted",
-      "The request has been accepted for processing, but the processing "
-      "has "
-      "not been completed. The request might or might not eventually be "
-      "acted upon, as it might be disallowed when processing actually "
-      "takes "
-      "place.",
-      "https://httpstatuses.io/202"}},
-    {203,
-     {"Non-authoritative information",
-      "The request was successful but the enclosed payload has been "
-      "modified from that of the origin server's 200 OK response by a "
-      "transforming proxy.",
-      "https://httpstatuses.io/203"}},
-    {204,
-     {"No Content",
-      "The server has successfully fulfilled the request and that there is "
-      "no additional content to send in the response payload body.",
-      "https://httpstatuses.io/204"}},
-    {205,
-     {"Reset Content",
-      "The server has fulfilled the request and desires that the user "
-      "agent "
-      "reset the \"document view\", which caused the request to be sent, "
-      "to "
-      "its original state as received from the origin server.",
-      "https://httpstatuses.io/205"}},
-    {206,
-     {"Partial Content",
-      "The server is successfully fulfilling a range request for the "
-      "target "
-      "resource by transferring one or more parts of the selected "
-      "representation that correspond to the satisfiable ranges found in "
-      "the request's Range header field.",
-      "https://httpstatuses.io/206"}},
-    {207,
-     {"Multi-Status",
-      "A Multi-Status response conveys information about multiple "
-      "resources "
-      "in situations where multiple status codes might be appropriate.",
-      "https://httpstatuses.io/207"}},
-    {208,
-     {"Already Reported",
-      "Used inside a DAV: propstat response element to avoid enumerating "
-      "the internal members of multiple bindings to the same collection "
-      "repeatedly.",
-      "https://httpstatuses.io/208"}},
-    {226,
-     {"IM Used",
-      "The server has fulfilled a GET request for the resource, and the "
-      "response is a representation of the result of one or more "
-      "instance-manipulations applied to the current instance.",
-      "https://httpstatuses.io/226"}},
-    {300,
-     {"Multiple Choices",
-      "The target resource has more than one representation, each with its "
-      "own more specific identifier, and information about the "
-      "alternatives is being provided so that the user (or user agent) can "
-      "select a preferred representation by redirecting its request to one "
-      "or more of those identifiers.",
-      "https://httpstatuses.io/300"}},
-    {301,
-     {"Moved Permanently",
-      "The target resource has been assigned a new permanent URI and any "
-      "future references to this resource ought to use one of the enclosed "
-      "URIs.",
-      "https://httpstatuses.io/301"}},
-    {302,
-     {"Found",
-      "The target resource resides temporarily under a different URI. "
-      "Since the redirection might be altered on occasion, the client "
-      "ought to continue to use the effective request URI for future "
-      "requests.",
-      "https://httpstatuses.io/302"}},
-    {303,
-     {"See Other",
-      "The server is redirecting the user agent to a different resource, "
-      "as indicated by a URI in the Location header field, which is "
-      "intended to provide an indirect response to the original request.",
-      "https://httpstatuses.io/303"}},
-    {304,
-     {"Not Modified",
-      "A conditional GET or HEAD request has been received and would have "
-      "resulted in a 200 OK response if it were not for the fact that the "
-      "condition evaluated to false.",
-      "https://httpstatuses.io/304"}},
-    {305,
-     {"Use Proxy",
-      "Defined in a previous version of this specification and is now "
-      "deprecated, due to security concerns regarding in-band "
-      "configuration of a proxy.",
-      "https://httpstatuses.io/305"}},
-    {307,
-     {"Temporary Redirect",
-      "The target resource resides temporarily under a different URI and "
-      "the user agent MUST NOT change the request method if it performs an "
-      "automatic redirection to that URI.",
-      "https://httpstatuses.io/307"}},
-    {308,
-     {"Permanent Redirect",
-      "The server has fulfilled a GET request for the resource, and the "
-      "response is a representation of the result of one or more "
-      "instance-manipulations applied to the current instance.",
-      "https://httpstatuses.io/308"}},
-    {400,
-     {"Bad Request",
-      "The server cannot or will not process the request due to something "
-      "that is perceived to be a client error (e.g., malformed request "
-      "syntax, invalid request message framing, or deceptive request "
-      "routing).",
-      "https://httpstatuses.io/400"}},
-    {401,
-     {"Unauthorized",
-      "The request has not been applied because it lacks valid "
-      "authentication credentials for the target resource.",
-      "https://httpstatus.io/401"}},
-    {402,
-     {"Payment Required", "Reserved for future use.",
-      "https://httpstatuses.io/402"}},
-    {403,
-     {"Forbidden",
-      "The server understood the request but refuses to authorize it.",
-      "https://httpstatuses.io/403"}},
-    {404,
-     {"Not Found",
-      "The origin server did not find a current representation for the "
-      "target resource or is not willing to disclose that one exists.",
-      "https://httpstatuses.io/404"}},
-    {405,
-     {"Method Not Allowed",
-      "The method received in the request-line is known by the origin "
-      "server but not supported by the target resource.",
-      "https://httpstatuses.io/405"}},
-    {406,
-     {"Not Acceptable",
-      "The target resource does not have a current representation that "
-      "would be acceptable to the user agent, according to the proactive "
-      "negotiation header fields received in the request, and the server "
-      "is unwilling to supply a default representation.",
-      "https://httpstatuses.io/406"}},
-    {407,
-     {"Proxy Authentication Required",
-      "Similar to 401 Unauthorized, but it indicates that the client needs "
-      "to authenticate itself in order to use a proxy.",
-      "https://httpstatuses.io/407"}},
-    {408,
-     {"Request Timeout",
-      "The server did not receive a complete request message within the "
-      "time that it was prepared to wait.",
-      "https://httpstatuses.io/408"}},
-    {409,
-     {"Conflict",
-      "The request could not be completed due to a conflict with the "
-      "current state of the target resource. This code is used in "
-      "situations where the user might be able to resolve the conflict and "
-      "resubmit the request.",
-      "https://httpstatuses.io/409"}},
-    {410,
-     {"Gone",
-      "The target resource is no longer available at the origin server and "
-      "that this condition is likely to be permanent.",
-      "https://httpstatuses.io/410"}},
-    {411,
-     {"Length Required",
-      "The server refuses to accept the request without a defined "
-      "Content-Length.",
-      "https://httpstatuses.io/411"}},
-    {412,
-     {"Precondition Failed",
-      "One or more conditions given in the request header fields evaluated "
-      "to false when tested on the server.",
-      "https://httpstatuses.io/412"}},
-    {413,
-     {"Payload Too Large",
-      "The server is refusing to process a request because the request "
-      "payload is larger than the server is willing or able to process.",
-      "https://httpstatuses.io/413"}},
-    {414,
-     {"Request-URI Too Long",
-      "The server is refusing to service the request because the "
-      "request-target is longer than the server is willing to interpret.",
-      "https://httpstatuses.io/414"}},
-    {415,
-     {"Unsupported Media Type",
-      "The origin server is refusing to service the request because the "
-      "payload is in a format not supported by this method on the target "
-      "resource.",
-      "https://httpstatuses.io/415"}},
-    {416,
-     {"Requested Range Not Satisfiable",
-      "None of the ranges in the request's Range header field1 overlap the "
-      "current extent of the selected resource or that the set of ranges "
-      "requested has been rejected due to invalid ranges or an excessive "
-      "request of small or overlapping ranges.",
-      "https://httpstatuses.io/416"}},
-    {417,
-     {"Expectation Failed",
-      "The expectation given in the request's Expect header field could "
-      "not be met by at least one of the inbound servers.",
-      "https://httpstatuses.io/417"}},
-    {418,
-     {"I’m a teapot",
-      "Any attempt to brew coffee with a teapot should result in the error "
-      "code \"418 I'm a teapot\". The resulting entity body MAY be short "
-      "and stout.",
-      "https://httpstatuses.io/418"}},
-    {421,
-     {"Misdirected Request",
-      "The request was directed at a server that is not able to produce a "
-      "response. This can be sent by a server that is not configured to "
-      "produce responses for the combination of scheme and authority that "
-      "are included in the request URI.",
-      "https://httpstatuses.io/421"}},
-    {422,
-     {"Unprocessable Entity",
-      "The server understands the content type of the request entity "
-      "(hence a 415 Unsupported Media Type status code is inappropriate), "
-      "and the syntax of the request entity is correct (thus a 400 Bad "
-      "Request status code is inappropriate) but was unable to process the "
-      "contained instructions.",
-      "https://httpstatuses.io/422"}},
-    {423,
-     {"Locked", "The source or destination resource of a method is locked.",
-      "https://httpstatuses.io/423"}},
-    {424,
-     {"Failed Dependency",
-      "The method could not be performed on the resource because the "
-      "requested action depended on another action and that action "
-      "failed.",
-      "https://httpstatuses.io/424"}},
-    {426,
-     {"Upgrade Required",
-      "The server refuses to perform the request using the current "
-      "protocol but might be willing to do so after the client upgrades to "
-      "a different protocol.",
-      "https://httpstatuses.io/426"}},
-    {428,
-     {"Precondition Required",
-      "The origin server requires the request to be conditional.",
-      "https://httpstatuses.io/428"}},
-    {429,
-     {"Too Many Requests",
-      "The user has sent too many requests in a given amount of time "
-      "(\"rate limiting\").",
-      "https://httpstatuses.io/429"}},
-    {431,
-     {"Request Header Fields Too Large",
-      "The server is unwilling to process the request because its header "
-      "fields are too large. The request MAY be resubmitted after reducing "
-      "the size of the request header fields.",
-      "https://httpstatuses.io/431"}},
-    {444,
-     {"Connection Closed Without Response",
-      "A non-standard status code used to instruct nginx to close the "
-      "connection without sending a response to the client, most commonly "
-      "used to deny malicious or malformed requests.",
-      "https://httpstatuses.io/444"}},
-    {451,
-     {"Unavailable For Legal Reasons",
-      "The server is denying access to the resource as a consequence of a "
-      "legal demand.",
-      "https://httpstatuses.io/451"}},
-    {499,
-     {"Client Closed Request",
-      "A non-standard status code introduced by nginx for the case when a "
-      "client closes the connection while nginx is processing the "
-      "request.",
-      "https://httpstatuses.io/499"}},
-    {500,
-     {"Internal Server Error",
-      "The server encountered an unexpected condition that prevented it "
-      "from fulfilling the request.",
-      "https://httpstatuses.io/500"}},
-    {501,
-     {"Not Implemented",
-      "The server does not support the functionality required to fulfill "
-      "the request.",
-      "https://httpstatuses.io/501"}},
-    {502,
-     {"Bad Gateway",
-      "The server, while acting as a gateway or proxy, received an invalid "
-      "response from an inbound server it accessed while attempting to "
-      "fulfill the request.",
-      "https://httpstatuses.io/502"}},
-    {503,
-     {"Service Unavailable",
-      "The server is currently unable to handle the request due to a "
-      "temporary overload or scheduled maintenance, which will likely be "
-      "alleviated after some delay.",
-      "https://httpstatuses.io/503"}},
-    {504,
-     {"Gateway Timeout",
-      "The server, while acting as a gateway or proxy, did not receive a "
-      "timely response from an upstream server it needed to access in "
-      "order to complete the request.",
-      "https://httpstatuses.io/504"}},
-    {505,
-     {"HTTP Version Not Supported",
-      "The server does not support, or refuses to support, the major "
-      "version of HTTP that was used in the request message.",
-      "https://httpstatuses.io/505"}},
-    {506,
-     {"Variant Also Negotiates",
-      "The server has an internal configuration error: the chosen variant "
-      "resource is configured to engage in transparent content negotiation "
-      "itself, and is therefore not a proper end point in the negotiation "
-      "process.",
-      "https://httpstatuses.io/506"}},
-    {507,
-     {"Insufficient Storage",
-      "The method could not be performed on the resource because the "
-      "server is unable to store the representation needed to successfully "
-      "complete the request.",
-      "https://httpstatuses.io/507"}},
-    {508,
-     {"Loop Detected",
-      "The server terminated an operation because it encountered an "
-      "infinite loop while processing a request with \"Depth: infinity\". "
-      "This status indicates that the entire operation failed.",
-      "https://httpstatuses.io/508"}},
-    {510,
-     {"Not Extended",
-      "The policy for accessing the resource has not been met in the "
-      "request. The server should send back all the information necessary "
-      "for the client to issue an extended request.",
-      "https://httpstatuses.io/510"}},
-    {511,
-     {"Network Authentication Required",
-      "The client needs to authenticate to gain network access.",
-      "https://httpstatuses.io/511"}},
-    {599,
-     {"Network Connect Timeout Error",
-      "This status code is not specified in any RFCs, but is used by some "
-      "HTTP proxies to signal a network connect timeout behind the proxy "
-      "to a client in front of the proxy.",
-      "https://httpstatuses.io/599"}},
-};
+namespace httpcode {
 
 /// STDOUT messages
 
 static constexpr std::string_view invalid_num_arguments =
     "Error: Invalid number of arguments given.\n";
 
-static constexpr std::string_view invalid_code =
-    "Error: Invalid HTTP status code.\n";
+static constexpr std::string_view usage =
+    "Usage: httpcode [<options>] <code> | <query> | list [<category-name>]\n"
+    "       httpcode [<options>] --stdin\n"
+    "       httpcode [<options>] histogram [-j <threads>] [--only <query>] "
+    "[--latency <field>]\n"
+    "                  [--top-by path|client|upstream <k>] "
+    "[--upstream-field <field>]\n"
+    "                  [--io mmap|read|uring] [--direct] "
+    "[--sample <rate> | --budget <seconds>]\n"
+    "                  [--snapshot] <logfile>...\n"
+    "       httpcode merge <snapshot>...\n"
+    "       httpcode [<options>] report [--only <query>] <snapshot>...\n"
+    "       httpcode grep [-c] [-v] [-A <n>] [-B <n>] [-C <n>] <query> "
+    "<logfile>...\n"
+    "       httpcode watch <logfile>\n"
+    "       httpcode search <term>...\n"
+    "       httpcode compile-registry <source.toml> <file>\n"
+    "       httpcode serve --socket <path>\n"
+    "       httpcode client --socket <path> [<request>...]\n"
+    "       httpcode loadgen --socket <path> [-c <connections>] [-d <depth>] "
+    "[-n <requests>] [<request>]\n"
+    "Options: --registry <file>  overlay a compiled registry\n"
+    "         --format <format>  text, json, ndjson, csv or bin\n"
+    "         --stats[=json]     print counters and timings to stderr\n"
+    "Queries: comma-separated codes (404), ranges (500-511), patterns (5xx, "
+    "50x)\n"
+    "         and category names; a leading '-' excludes a term (4xx,-404)\n";
+
+/// Option values
 
-static constexpr std::string_view invalid_category =
-    "Error: Invalid HTTP status category name. Valid names are informational, "
-    "success, redirection, client-error, and server-error.\n";
+// Parses a count of at most `max` that makes up the whole of `value`, unlike
+// `to_digit`, which stops at the first character that is not a digit.
+std::optional<unsigned int> parse_count(std::string_view value,
+                                        unsigned int max) noexcept {
+  unsigned int n = 0;
+  const auto [end, ec] =
+      std::from_chars(value.data(), value.data() + value.size(), n);
+  if (ec != std::errc() || end != value.data() + value.size() || n > max) {
+    return std::nullopt;
+  }
+  return n;
+}
 
-static constexpr std::string_view usage =
-    "Usage: httpcode <code> | list [<category-name>]\n";
+/// Log analysis
+
+// Command line options shared by the log analysis subcommands.
+struct log_options {
+  unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+  // Codes to report, or every code if unset.
+  std::optional<code_set> only;
+  // Field holding the request time, or 0 for none.
+  int latency_field = 0;
+  // Key to attribute codes to, and the field holding upstream addresses.
+  std::optional<top_key> top_by;
+  std::size_t top_k = 0;
+  int upstream_field = 0;
+  // How to read plain log files.
+  io_backend io = io_backend::mmap;
+  bool direct = false;
+  // Fraction of the logs to sample, or the time to sample them for, to
+  // estimate the histogram instead of counting it.
+  double sample_rate = 0;
+  std::uint64_t budget_micros = 0;
+  // Whether to write a snapshot instead of printing the results.
+  bool snapshot = false;
+  std::vector<const char*> paths;
+};
+
+// Parses a field number for `find_field`, which may be negative.
+std::optional<int> parse_field(std::string_view value) noexcept {
+  const bool from_end = value.starts_with('-');
+  const auto field = parse_count(from_end ? value.substr(1) : value, 1024);
+  if (!field.has_value() || *field == 0) {
+    return std::nullopt;
+  }
+  const int n = static_cast<int>(*field);
+  return from_end ? -n : n;
+}
+
+// Parses `[-j N] [--only <query>] [--latency <field>] [--top-by <key> <k>]
+// [--upstream-field <field>] [--io <backend>] [--direct] [--sample <rate>]
+// [--budget <seconds>] [--snapshot] <logfile>...` from `args`.
+tl::expected<log_options, std::invalid_argument> parse_log_options(
+    std::span<char* const> args) {
+  log_options options;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    const std::string_view arg = args[i];
+    if (arg == "-j" || (arg.starts_with("-j") && arg.size() > 2)) {
+      std::string_view value = arg.substr(2);
+      if (value.empty() && ++i < args.size()) {
+        value = args[i];
+      }
+      const auto threads = parse_count(value, 1024);
+      if (!threads.has_value() || *threads == 0) {
+        return tl::make_unexpected(
+            std::invalid_argument("Invalid number of threads."));
+      }
+      options.threads = *threads;
+    } else if (arg == "--only" && i + 1 < args.size()) {
+      auto only = parse_code_query(args[++i]);
+      if (!only.has_value()) {
+        return tl::make_unexpected(only.error());
+      }
+      options.only = *only;
+    } else if (arg == "--latency" && i + 1 < args.size()) {
+      const auto field = parse_field(args[++i]);
+      if (!field.has_value()) {
+        return tl::make_unexpected(
+            std::invalid_argument("Invalid latency field."));
+      }
+      options.latency_field = *field;
+    } else if (arg == "--top-by" && i + 2 < args.size()) {
+      options.top_by = find_top_key(args[++i]);
+      const auto k = parse_count(args[++i], 1000);
+      if (!options.top_by.has_value() || !k.has_value() || *k == 0) {
+        return tl::make_unexpected(
+            std::invalid_argument("Invalid --top-by key or count."));
+      }
+      options.top_k = *k;
+    } else if (arg == "--upstream-field" && i + 1 < args.size()) {
+      const auto field = parse_field(args[++i]);
+      if (!field.has_value()) {
+        return tl::make_unexpected(
+            std::invalid_argument("Invalid upstream field."));
+      }
+      options.upstream_field = *field;
+    } else if (arg == "--io" && i + 1 < args.size()) {
+      const auto io = find_io_backend(args[++i]);
+      if (!io.has_value()) {
+        return tl::make_unexpected(
+            std::invalid_argument("Invalid I/O backend."));
+      }
+      options.io = *io;
+    } else if (arg == "--direct") {
+      options.direct = true;
+    } else if (arg == "--sample" && i + 1 < args.size()) {
+      const std::string_view value = args[++i];
+      double rate = 0;
+      const auto [end, ec] =
+          std::from_chars(value.data(), value.data() + value.size(), rate);
+      if (ec != std::errc() || end != value.data() + value.size() ||
+          !(rate > 0 && rate <= 1)) {
+        return tl::make_unexpected(
+            std::invalid_argument("Invalid sample rate, expected (0, 1]."));
+      }
+      options.sample_rate = rate;
+    } else if (arg == "--budget" && i + 1 < args.size()) {
+      // `parse_seconds` reads log fields and ignores what follows the number,
+      // which here would be a mistyped unit.
+      const std::string_view value = args[++i];
+      const auto micros = parse_seconds(value);
+      if (!micros.has_value() || *micros == 0 ||
+          value.find_first_not_of("0123456789.") != std::string_view::npos ||
+          std::count(value.begin(), value.end(), '.') > 1) {
+        return tl::make_unexpected(
+            std::invalid_argument("Invalid time budget."));
+      }
+      options.budget_micros = *micros;
+    } else if (arg == "--snapshot") {
+      options.snapshot = true;
+    } else {
+      options.paths.push_back(args[i]);
+    }
+  }
+  if (options.paths.empty()) {
+    return tl::make_unexpected(std::invalid_argument("No log file given."));
+  }
+  if (options.top_by == top_key::upstream && options.upstream_field == 0) {
+    return tl::make_unexpected(std::invalid_argument(
+        "--top-by upstream needs --upstream-field."));
+  }
+  if ((options.sample_rate != 0 || options.budget_micros != 0) &&
+      (options.latency_field != 0 || options.top_by.has_value() ||
+       options.snapshot ||
+       (options.sample_rate != 0 && options.budget_micros != 0))) {
+    return tl::make_unexpected(std::invalid_argument(
+        "--sample and --budget exclude each other, --latency, --top-by and "
+        "--snapshot."));
+  }
+  // Snapshots have no room for the sketches.
+  if (options.top_by.has_value() && options.snapshot) {
+    return tl::make_unexpected(
+        std::invalid_argument("--top-by excludes --snapshot."));
+  }
+  return options;
+}
+
+// Prints the results of an analysis in `format`. Request times are only
+// printed if `latencies` is set. Top keys are printed as text only, which
+// `run_histogram` checks before building them.
+int print_analysis(const log_analysis& analysis, bool latencies,
+                   const registry& names, output_format format) {
+  const latency_counts* l = latencies ? &analysis.latencies : nullptr;
+  output_buffer out(STDOUT_FILENO);
+  if (format == output_format::text) {
+    append_histogram(out, analysis.counts, names, l,
+                     analysis.top.has_value() ? &*analysis.top : nullptr);
+  } else {
+    write_count_records(out, format, analysis.counts, names, l);
+  }
+  return out.flush() ? 0 : 1;
+}
+
+// Estimates the histogram of the logs in `options` from a sample of them and
+// prints it with confidence intervals.
+int run_sample(const log_options& options, const registry& names,
+               output_format format) {
+  if (format != output_format::text) {
+    print(STDERR_FILENO,
+          {"Error: Sampled histograms are printed as text only.\n", usage});
+    return 1;
+  }
+  sample_options sampling;
+  sampling.rate = options.sample_rate;
+  sampling.budget = std::chrono::microseconds(options.budget_micros);
+  sampling.threads = options.threads;
+  sampling.only = options.only.has_value() ? &*options.only : nullptr;
+  const auto estimate = sample_logs(options.paths, sampling);
+  if (!estimate.has_value()) {
+    print(STDERR_FILENO, {"Error: ", estimate.error().what(), "\n"});
+    return 1;
+  }
+  output_buffer out(STDOUT_FILENO);
+  append_sample_histogram(out, *estimate, names);
+  return out.flush() ? 0 : 1;
+}
+
+// Counts the status codes in the given access logs, along with their request
+// times with `--latency`, and prints them or writes them as a snapshot.
+int run_histogram(std::span<char* const> args, const registry& names,
+                  output_format format = output_format::text) {
+  const auto options = parse_log_options(args);
+  if (!options.has_value()) {
+    print(STDERR_FILENO, {"Error: ", options.error().what(), "\n", usage});
+    return 1;
+  }
+
+  if (options->sample_rate != 0 || options->budget_micros != 0) {
+    return run_sample(*options, names, format);
+  }
+  if (options->top_by.has_value() && format != output_format::text) {
+    print(STDERR_FILENO,
+          {"Error: Top keys are printed as text only.\n", usage});
+    return 1;
+  }
+
+  auto analysis = analyze_logs(
+      options->paths, {.threads = options->threads,
+                       .latency_field = options->latency_field,
+                       .top_by = options->top_by,
+                       .top_k = options->top_k,
+                       .upstream_field = options->upstream_field,
+                       .io = options->io,
+                       .direct = options->direct,
+                       .only = options->only.has_value() ? &*options->only
+                                                         : nullptr});
+  if (!analysis.has_value()) {
+    print(STDERR_FILENO, {"Error: ", analysis.error().what(), "\n"});
+    return 1;
+  }
+  if (options->only.has_value()) {
+    analysis->keep_only(*options->only);
+  }
+
+  const bool latencies = options->latency_field != 0;
+  if (options->snapshot) {
+    output_buffer out(STDOUT_FILENO);
+    append_snapshot(out, *analysis, latencies);
+    return out.flush() ? 0 : 1;
+  }
+  return print_analysis(*analysis, latencies, names, format);
+}
+
+// Adds up the snapshots in `args` and writes the sum as a snapshot.
+int run_merge(std::span<char* const> args) {
+  if (args.empty()) {
+    print(STDERR_FILENO, {invalid_num_arguments, usage});
+    return 1;
+  }
+  log_analysis total;
+  const auto latencies = read_snapshots(args, total);
+  if (!latencies.has_value()) {
+    print(STDERR_FILENO, {"Error: ", latencies.error().what(), "\n"});
+    return 1;
+  }
+  output_buffer out(STDOUT_FILENO);
+  append_snapshot(out, total, *latencies);
+  return out.flush() ? 0 : 1;
+}
+
+// Adds up the snapshots in `[--only <query>] <snapshot>...` and prints them
+// as `histogram` would.
+int run_report(std::span<char* const> args, const registry& names,
+               output_format format = output_format::text) {
+  std::optional<code_set> only;
+  if (args.size() >= 2 && std::string_view(args[0]) == "--only") {
+    auto parsed = parse_code_query(args[1]);
+    if (!parsed.has_value()) {
+      print(STDERR_FILENO, {"Error: ", parsed.error().what(), "\n", usage});
+      return 1;
+    }
+    only = *parsed;
+    args = args.subspan(2);
+  }
+  if (args.empty()) {
+    print(STDERR_FILENO, {invalid_num_arguments, usage});
+    return 1;
+  }
+
+  log_analysis total;
+  const auto latencies = read_snapshots(args, total);
+  if (!latencies.has_value()) {
+    print(STDERR_FILENO, {"Error: ", latencies.error().what(), "\n"});
+    return 1;
+  }
+  if (only.has_value()) {
+    total.keep_only(*only);
+  }
+  return print_analysis(total, *latencies, names, format);
+}
+
+// Prints the line rates of the log at `<logfile>` once per second.
+int run_watch(std::span<char* const> args) {
+  if (args.size() != 1) {
+    print(STDERR_FILENO, {invalid_num_arguments, usage});
+    return 1;
+  }
+  const auto result = watch_log(args[0], STDOUT_FILENO);
+  if (!result.has_value()) {
+    print(STDERR_FILENO, {"Error: Cannot watch '", args[0], "': ",
+                          result.error().message(), "\n"});
+    return 1;
+  }
+  return 0;
+}
+
+/// Line extraction
+
+// Prints the lines of the logs in `[-c] [-v] [-A n] [-B n] [-C n] <query>
+// <logfile>...` whose status is in the query. Exits with 0 if any line was
+// selected, 1 if none was and 2 on errors, like grep(1).
+int run_grep(std::span<char* const> args) {
+  grep_options options;
+  std::optional<code_set> query;
+  std::vector<const char*> paths;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    const std::string_view arg = args[i];
+    if (arg == "-c") {
+      options.count = true;
+    } else if (arg == "-v") {
+      options.invert = true;
+    } else if (arg.size() >= 2 && arg[0] == '-' &&
+               (arg[1] == 'A' || arg[1] == 'B' || arg[1] == 'C')) {
+      std::string_view value = arg.substr(2);
+      if (value.empty() && i + 1 < args.size()) {
+        value = args[++i];
+      }
+      const auto n = parse_count(value, std::numeric_limits<int>::max());
+      if (!n.has_value()) {
+        print(STDERR_FILENO,
+              {"Error: Invalid value for '", arg.substr(0, 2), "'\n", usage});
+        return 2;
+      }
+      if (arg[1] != 'A') options.before = *n;
+      if (arg[1] != 'B') options.after = *n;
+    } else if (!query.has_value()) {
+      auto parsed = parse_code_query(arg);
+      if (!parsed.has_value()) {
+        print(STDERR_FILENO, {"Error: ", parsed.error().what(), "\n", usage});
+        return 2;
+      }
+      query = *parsed;
+    } else {
+      paths.push_back(args[i]);
+    }
+  }
+  if (paths.empty()) {
+    print(STDERR_FILENO, {invalid_num_arguments, usage});
+    return 2;
+  }
+  options.codes = *query;
+
+  const auto selected = grep_logs(paths, options, STDOUT_FILENO);
+  if (!selected.has_value()) {
+    print(STDERR_FILENO, {"Error: ", selected.error().what(), "\n"});
+    return 2;
+  }
+  return *selected != 0 ? 0 : 1;
+}
+
+/// Search
+
+// Prints the codes whose descriptions contain every term in `args`, best match
+// first, separated by blank lines.
+int run_search(std::span<char* const> args) {
+  if (args.empty()) {
+    print(STDERR_FILENO, {invalid_num_arguments, usage});
+    return 1;
+  }
+  std::array<std::string_view, max_search_terms> query;
+  const std::size_t query_size = std::min(args.size(), query.size());
+  std::copy_n(args.begin(), query_size, query.begin());
 
-/// Utility functions
+  search_results hits;
+  const std::size_t count = search(std::span(query.data(), query_size), hits);
+  if (count == 0) {
+    print(STDERR_FILENO, {"Error: No HTTP status code matches the search.\n"});
+    return 1;
+  }
 
-tl::expected<int, std::exception> to_digit(std::string_view s) noexcept {
-  try {
-    return std::stoi(std::string(s));
-  } catch (const std::exception& e) {
-    return tl::make_unexpected(e);
+  output_buffer out(STDOUT_FILENO);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (i > 0) out.append('\n');
+    append_output(out, hits[i].code, *find_code(hits[i].code));
   }
+  return out.flush() ? 0 : 1;
 }
 
-std::string format_output(unsigned int code, std::string_view short_desc,
-                          std::string_view long_desc,
-                          std::string_view learn_more_url) noexcept {
-  std::ostringstream oss;
-  oss << code << " " << short_desc << '\n'
-      << long_desc << "\n\n"
-      << "Learn more: " << learn_more_url << '\n';
-  return oss.str();
+/// Custom registries
+
+// Compiles `<source.toml> <file>`. The file is written under a temporary name
+// and renamed into place, so processes that have the old one mapped keep
+// reading a consistent copy.
+int run_compile_registry(std::span<char* const> args) {
+  if (args.size() != 2) {
+    print(STDERR_FILENO, {invalid_num_arguments, usage});
+    return 1;
+  }
+  const auto source = mapped_file::open(args[0]);
+  if (!source.has_value()) {
+    print(STDERR_FILENO, {"Error: Cannot read '", args[0], "': ",
+                          source.error().message(), "\n"});
+    return 1;
+  }
+  const auto image = compile_registry(source->view());
+  if (!image.has_value()) {
+    print(STDERR_FILENO,
+          {"Error: ", args[0], ": ", image.error().what(), "\n"});
+    return 1;
+  }
+
+  const std::string temp = std::string(args[1]) + ".tmp";
+  const int fd =
+      ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  bool ok = fd >= 0 && write_all(fd, *image);
+  ok = fd >= 0 && ::close(fd) == 0 && ok;
+  if (!ok || std::rename(temp.c_str(), args[1]) != 0) {
+    const std::error_code error(errno, std::generic_category());
+    ::unlink(temp.c_str());
+    print(STDERR_FILENO, {"Error: Cannot write '", args[1], "': ",
+                          error.message(), "\n"});
+    return 1;
+  }
+  return 0;
 }
 
-std::string list_all_codes() noexcept {
-  std::ostringstream oss;
-  oss << "-----------------\n"
-      << "HTTP Status Codes\n"
-      << "-----------------\n";
-  for (const auto& [code, desc] : codes) {
-    const auto& [short_desc, _1, _2] = desc;
-    oss << code << " " << short_desc << '\n';
+// Returns the status code in `arg` if it consists of digits only, so that
+// queries such as `500-511` are not taken for a code.
+tl::expected<int, std::errc> to_code(std::string_view arg) noexcept {
+  if (arg.find_first_not_of("0123456789") != std::string_view::npos) {
+    return tl::make_unexpected(std::errc::invalid_argument);
   }
-  return oss.str();
+  return to_digit(arg);
 }
 
-tl::expected<std::string, std::exception> list_all_codes_for_category(
-    std::string_view category) noexcept {
-  std::ostringstream oss;
-  std::map<unsigned int, description>::const_iterator lo;
-  std::map<unsigned int, description>::const_iterator hi;
-  if (category == "informational") {
-    lo = codes.lower_bound(100);
-    hi = codes.upper_bound(199);
-    oss << "-----------------\n"
-        << "1xx Informational\n"
-        << "-----------------\n";
-  } else if (category == "success") {
-    lo = codes.lower_bound(200);
-    hi = codes.upper_bound(299);
-    oss << "-----------\n"
-        << "2xx Success\n"
-        << "-----------\n";
-  } else if (category == "redirection") {
-    lo = codes.lower_bound(300);
-    hi = codes.upper_bound(399);
-    oss << "---------------\n"
-        << "3xx Redirection\n"
-        << "---------------\n";
-  } else if (category == "client-error") {
-    lo = codes.lower_bound(400);
-    hi = codes.upper_bound(499);
-    oss << "----------------\n"
-        << "4xx Client Error\n"
-        << "----------------\n";
-  } else if (category == "server-error") {
-    lo = codes.lower_bound(500);
-    hi = codes.upper_bound(599);
-    oss << "-----------------\n"
-        << "5xx Server Error:\n"
-        << "-----------------\n";
+// Runs `[--registry <file>] [--format <format>] <command>...`, with the
+// registry in <file> overlaid on the built-in table and the output written in
+// the given format. None of the pre-rendered answers apply, so everything is
+// rendered at run time.
+int run_with_options(std::span<char* const> args) {
+  std::optional<registry> names;
+  output_format format = output_format::text;
+  while (args.size() >= 2 && (std::string_view(args[0]) == "--registry" ||
+                              std::string_view(args[0]) == "--format")) {
+    if (std::string_view(args[0]) == "--format") {
+      const auto f = find_output_format(args[1]);
+      if (!f.has_value()) {
+        print(STDERR_FILENO,
+              {"Error: Invalid output format '", args[1], "'\n", usage});
+        return 1;
+      }
+      format = *f;
+    } else {
+      auto opened = registry::open(args[1]);
+      if (!opened.has_value()) {
+        print(STDERR_FILENO, {"Error: ", opened.error().what(), "\n"});
+        return 1;
+      }
+      names = std::move(*opened);
+    }
+    args = args.subspan(2);
+  }
+  if (args.empty()) {
+    print(STDERR_FILENO, {invalid_num_arguments, usage});
+    return 1;
+  }
+  if (!names.has_value()) {
+    names.emplace();
+  }
+
+  const std::string_view command = args[0];
+  const auto rest = args.subspan(1);
+  if (command == "--stdin" && rest.empty()) {
+    return run_batch(STDIN_FILENO, STDOUT_FILENO, *names, format) ? 0 : 1;
+  } else if (command == "histogram") {
+    return run_histogram(rest, *names, format);
+  } else if (command == "report") {
+    return run_report(rest, *names, format);
+  }
+
+  output_buffer out(STDOUT_FILENO);
+  const auto code = to_code(command);
+  const auto desc = code.has_value() ? names->find(*code) : std::nullopt;
+  const category* c = nullptr;
+  bool query = false;
+  code_set selected;
+  if (code.has_value()) {
+    if (!desc.has_value()) {
+      print(STDERR_FILENO, {invalid_code, usage});
+      return 1;
+    }
+    selected.insert(static_cast<unsigned int>(*code));
+  } else if (command == "list" && rest.size() == 1) {
+    c = find_category(rest[0]);
+    if (c == nullptr) {
+      print(STDERR_FILENO, {invalid_category});
+      return 1;
+    }
+    selected.insert_range(c->first_code, c->last_code);
+  } else if (command == "list" && rest.empty()) {
+    selected = code_set::all();
+  } else if (const auto parsed = parse_code_query(command);
+             parsed.has_value() && rest.empty()) {
+    selected = *parsed;
+    query = true;
   } else {
-    return tl::make_unexpected(std::invalid_argument("Invalid category name."));
+    print(STDERR_FILENO, {"Error: Invalid command '", command, "'\n", usage});
+    return 1;
   }
 
-  for (; lo != hi; ++lo) {
-    const auto& [code, info] = *lo;
-    const auto& [short_desc, _1, _2] = info;
-    oss << code << " " << short_desc << '\n';
+  if (format != output_format::text) {
+    write_status_records(out, format, *names, selected);
+  } else if (desc.has_value()) {
+    append_output(out, *code, *desc);
+  } else if (c != nullptr) {
+    append_category_list(out, *names, *c);
+  } else if (query) {
+    append_query_list(out, *names, selected);
+  } else {
+    append_list(out, *names);
   }
+  return out.flush() ? 0 : 1;
+}
+
+/// Lookup daemon
 
-  return oss.str();
+// Removes `--socket <path>` from `args` and returns the path, or nullptr if the
+// option is missing.
+const char* take_socket_option(std::vector<std::string_view>& args) {
+  const auto it = std::find(args.begin(), args.end(), "--socket");
+  if (it == args.end() || it + 1 == args.end()) {
+    return nullptr;
+  }
+  const char* path = (it + 1)->data();
+  args.erase(it, it + 2);
+  return path;
 }
 
-}  // namespace httpcode
+int run_serve(std::vector<std::string_view> args) {
+  const char* path = take_socket_option(args);
+  if (path == nullptr || !args.empty()) {
+    print(STDERR_FILENO, {invalid_num_arguments, usage});
+    return 1;
+  }
+  const auto result = serve(path);
+  if (!result.has_value()) {
+    print(STDERR_FILENO, {"Error: Cannot serve on '", path, "': ",
+                          result.error().message(), "\n"});
+    return 1;
+  }
+  return 0;
+}
+
+int run_client_command(std::vector<std::string_view> args) {
+  const char* path = take_socket_option(args);
+  if (path == nullptr) {
+    print(STDERR_FILENO, {invalid_num_arguments, usage});
+    return 1;
+  }
+  const auto result = run_client(path, args);
+  if (!result.has_value()) {
+    print(STDERR_FILENO, {"Error: Cannot query '", path, "': ",
+                          result.error().message(), "\n"});
+    return 1;
+  }
+  return *result ? 0 : 1;
+}
+
+int run_loadgen(std::vector<std::string_view> args) {
+  const char* path = take_socket_option(args);
+  if (path == nullptr) {
+    print(STDERR_FILENO, {invalid_num_arguments, usage});
+    return 1;
+  }
+
+  load_options options;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    if (args[i] == "-c" || args[i] == "-d" || args[i] == "-n") {
+      const auto value =
+          i + 1 < args.size()
+              ? parse_count(args[i + 1], std::numeric_limits<int>::max())
+              : std::nullopt;
+      if (!value.has_value() || *value == 0) {
+        print(STDERR_FILENO,
+              {"Error: Invalid value for '", args[i], "'\n", usage});
+        return 1;
+      }
+      if (args[i] == "-c") options.connections = *value;
+      if (args[i] == "-d") options.depth = *value;
+      if (args[i] == "-n") options.requests = *value;
+      ++i;
+    } else {
+      options.request = args[i];
+    }
+  }
+
+  const auto result = run_load(path, options);
+  if (!result.has_value()) {
+    print(STDERR_FILENO, {"Error: Cannot load '", path, "': ",
+                          result.error().message(), "\n"});
+    return 1;
+  }
+  return 0;
+}
+
+/// Instrumentation
+
+enum class stats_output { none, text, json };
+
+// Removes `--stats` or `--stats=json` from the options before the command,
+// so that it applies to every command. Arguments of the command itself, as in
+// `grep --stats x.log`, are left alone.
+stats_output take_stats_option(int& argc, char* argv[]) noexcept {
+  stats_output output = stats_output::none;
+  int kept = 1;
+  int i = 1;
+  for (; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--stats") {
+      output = stats_output::text;
+    } else if (arg == "--stats=json") {
+      output = stats_output::json;
+    } else if ((arg == "--registry" || arg == "--format") && i + 1 < argc) {
+      argv[kept++] = argv[i++];
+      argv[kept++] = argv[i];
+    } else {
+      break;
+    }
+  }
+  for (; i < argc; ++i) {
+    argv[kept++] = argv[i];
+  }
+  argc = kept;
+  argv[argc] = nullptr;
+  return output;
+}
+
+// Runs the command in `argv`, which no longer holds `--stats`.
+int run_command(int argc, char* argv[]) {
+  using httpcode::print;
 
-int main(int argc, char* argv[]) {
   if (argc <= 1) {
-    std::cerr << httpcode::invalid_num_arguments;
-    std::cerr << httpcode::usage;
+    print(STDERR_FILENO, {httpcode::invalid_num_arguments, httpcode::usage});
     return 1;
   }
 
+  // Every answer that depends only on the status code table is pre-rendered,
+  // so printing it is a single write(2).
   const std::string_view arg1 = argv[1];
-  const auto code = httpcode::to_digit(arg1);
-  if (code.has_value() && httpcode::codes.contains(*code)) {
-    const auto& [short_desc, long_desc, url] = httpcode::codes.at(*code);
-    std::cout << httpcode::format_output(*code, short_desc, long_desc, url);
-    return 0;
+  const auto code = httpcode::to_code(arg1);
+  const auto output =
+      code.has_value() ? httpcode::rendered_code(*code) : std::nullopt;
+  if (output.has_value()) {
+    return httpcode::write_all(STDOUT_FILENO, *output) ? 0 : 1;
   } else if (code.has_value()) {
-    std::cerr << httpcode::invalid_code;
-    std::cerr << httpcode::usage;
+    print(STDERR_FILENO, {httpcode::invalid_code, httpcode::usage});
     return 1;
   }
 
   if (arg1 == "help") {
-    std::cout << httpcode::usage;
+    print(STDOUT_FILENO, {httpcode::usage});
     return 0;
+  } else if (arg1 == "--stdin" && argc == 2) {
+    return httpcode::run_batch(STDIN_FILENO, STDOUT_FILENO,
+                               httpcode::registry())
+               ? 0
+               : 1;
+  } else if (arg1 == "--registry" || arg1 == "--format") {
+    return httpcode::run_with_options(std::span(argv + 1, argc - 1));
+  } else if (arg1 == "watch") {
+    return httpcode::run_watch(std::span(argv + 2, argc - 2));
+  } else if (arg1 == "grep") {
+    return httpcode::run_grep(std::span(argv + 2, argc - 2));
+  } else if (arg1 == "search") {
+    return httpcode::run_search(std::span(argv + 2, argc - 2));
+  } else if (arg1 == "compile-registry") {
+    return httpcode::run_compile_registry(std::span(argv + 2, argc - 2));
+  } else if (arg1 == "histogram") {
+    return httpcode::run_histogram(std::span(argv + 2, argc - 2),
+                                   httpcode::registry());
+  } else if (arg1 == "merge") {
+    return httpcode::run_merge(std::span(argv + 2, argc - 2));
+  } else if (arg1 == "report") {
+    return httpcode::run_report(std::span(argv + 2, argc - 2),
+                                httpcode::registry());
+  } else if (arg1 == "serve") {
+    return httpcode::run_serve({argv + 2, argv + argc});
+  } else if (arg1 == "client") {
+    return httpcode::run_client_command({argv + 2, argv + argc});
+  } else if (arg1 == "loadgen") {
+    return httpcode::run_loadgen({argv + 2, argv + argc});
   } else if (arg1 == "list" && argc == 3) {
     const std::string_view category = argv[2];
     const auto output = httpcode::list_all_codes_for_category(category);
     if (!output.has_value()) {
-      std::cerr << httpcode::invalid_category;
+      print(STDERR_FILENO, {httpcode::invalid_category});
+      return 1;
     }
-    std::cout << *output;
-    return 0;
+    return httpcode::write_all(STDOUT_FILENO, *output) ? 0 : 1;
   } else if (arg1 == "list") {
-    std::cout << httpcode::list_all_codes();
-    return 0;
+    return httpcode::write_all(STDOUT_FILENO, httpcode::list_all_codes()) ? 0
+                                                                           : 1;
   } else {
-    std::cerr << "Error: Invalid command '" << arg1 << "'\n";
-    std::cerr << httpcode::usage;
+    // Code queries, and the error message for anything else.
+    return httpcode::run_with_options(std::span(argv + 1, argc - 1));
   }
 }
+
+}  // namespace httpcode
+
+int main(int argc, char* argv[]) {
+  const auto stats = httpcode::take_stats_option(argc, argv);
+  if (stats == httpcode::stats_output::none) {
+    return httpcode::run_command(argc, argv);
+  }
+  if (!httpcode::stats::compiled_in) {
+    httpcode::print(STDERR_FILENO,
+                    {"Error: This build has no statistics support.\n"});
+    return 1;
+  }
+
+  httpcode::stats::enable();
+  const auto start = std::chrono::steady_clock::now();
+  const int status = httpcode::run_command(argc, argv);
+  httpcode::stats::print(STDERR_FILENO, httpcode::stats::collect(),
+                         std::chrono::steady_clock::now() - start,
+                         stats == httpcode::stats_output::json);
+  return status;
+}
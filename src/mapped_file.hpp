@@ -0,0 +1,104 @@
+#ifndef HTTPCODE_MAPPED_FILE_HPP_
+#define HTTPCODE_MAPPED_FILE_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tl/expected.hpp>
+#include <utility>
+
+#include "stats.hpp"
+
+namespace httpcode {
+
+// Error for inputs that are not regular files, such as pipes: their size is
+// not known up front, so they can be neither mapped nor read by offset.
+inline std::error_code not_regular_file() noexcept {
+  struct category : std::error_category {
+    const char* name() const noexcept override { return "httpcode"; }
+    std::string message(int) const override { return "not a regular file"; }
+  };
+  static const category c;
+  return {1, c};
+}
+
+// Read-only memory mapping of a whole file. Empty files map to an empty view;
+// anything but a regular file is refused.
+class mapped_file {
+ public:
+  mapped_file() noexcept = default;
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+  mapped_file(mapped_file&& other) noexcept
+      : data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0)) {}
+  mapped_file& operator=(mapped_file&& other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+  ~mapped_file() {
+    if (data_ != nullptr) {
+      ::munmap(data_, size_);
+    }
+  }
+
+  static tl::expected<mapped_file, std::error_code> open(
+      const char* path) noexcept {
+    const stats::scoped_timer timer(stats::stage::map);
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return tl::make_unexpected(
+          std::error_code(errno, std::generic_category()));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      const int err = errno;
+      ::close(fd);
+      return tl::make_unexpected(std::error_code(err, std::generic_category()));
+    }
+    if (!S_ISREG(st.st_mode)) {
+      ::close(fd);
+      return tl::make_unexpected(not_regular_file());
+    }
+
+    mapped_file file;
+    if (st.st_size > 0) {
+      void* data = ::mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                          PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        const int err = errno;
+        ::close(fd);
+        return tl::make_unexpected(
+            std::error_code(err, std::generic_category()));
+      }
+      ::madvise(data, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+      stats::add(stats::counter::map_calls);
+      stats::add(stats::counter::bytes_read,
+                 static_cast<std::size_t>(st.st_size));
+      file.data_ = data;
+      file.size_ = static_cast<std::size_t>(st.st_size);
+    }
+    ::close(fd);
+    return file;
+  }
+
+  std::string_view view() const noexcept {
+    return {static_cast<const char*>(data_), size_};
+  }
+
+ private:
+  void* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_MAPPED_FILE_HPP_
@@ -0,0 +1,220 @@
+#ifndef HTTPCODE_OUTPUT_BUFFER_HPP_
+#define HTTPCODE_OUTPUT_BUFFER_HPP_
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string_view>
+
+#include "stats.hpp"
+
+namespace httpcode {
+
+// Writes all of `data` to `fd`, retrying short and interrupted writes. Returns
+// false if a write failed.
+inline bool write_all(int fd, std::string_view data) noexcept {
+  const stats::scoped_timer timer(stats::stage::write);
+  while (!data.empty()) {
+    const ssize_t written = ::write(fd, data.data(), data.size());
+    stats::add(stats::counter::write_calls);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    stats::add(stats::counter::bytes_written,
+               static_cast<std::size_t>(written));
+    data.remove_prefix(static_cast<std::size_t>(written));
+  }
+  return true;
+}
+
+// Writes all `parts` to `fd`, with a single writev(2) unless it comes up short.
+inline bool print(int fd, std::initializer_list<std::string_view> parts) noexcept {
+  std::array<iovec, 8> iov;
+  std::size_t count = 0;
+  std::size_t total = 0;
+  for (const std::string_view part : parts) {
+    if (count == iov.size()) break;
+    iov[count++] = {const_cast<char*>(part.data()), part.size()};
+    total += part.size();
+  }
+  ssize_t written;
+  {
+    const stats::scoped_timer timer(stats::stage::write);
+    do {
+      written = ::writev(fd, iov.data(), static_cast<int>(count));
+      stats::add(stats::counter::write_calls);
+    } while (written < 0 && errno == EINTR);
+  }
+  if (written < 0) {
+    return false;
+  }
+  stats::add(stats::counter::bytes_written,
+             static_cast<std::size_t>(written));
+  if (static_cast<std::size_t>(written) == total && count == parts.size()) {
+    return true;
+  }
+
+  // Fall back to plain writes for whatever is left.
+  std::size_t skip = static_cast<std::size_t>(written);
+  for (std::string_view part : parts) {
+    const std::size_t n = std::min(skip, part.size());
+    part.remove_prefix(n);
+    skip -= n;
+    if (!write_all(fd, part)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Fixed-size output buffer that is flushed to a file descriptor with write(2).
+// It never allocates, so it can be reused across any number of records in a
+// hot loop. Once a write fails, further output is dropped and `failed()`
+// reports the error.
+class output_buffer {
+ public:
+  static constexpr std::size_t capacity = 64 * 1024;
+
+  explicit output_buffer(int fd) noexcept : fd_(fd) {}
+  output_buffer(const output_buffer&) = delete;
+  output_buffer& operator=(const output_buffer&) = delete;
+  ~output_buffer() { flush(); }
+
+  void append(std::string_view s) noexcept {
+    if (s.size() > capacity - size_) {
+      flush();
+      if (s.size() > capacity) {
+        write_all(s.data(), s.size());
+        return;
+      }
+    }
+    std::memcpy(data_.data() + size_, s.data(), s.size());
+    size_ += s.size();
+  }
+
+  void append(char c) noexcept {
+    if (size_ == capacity) {
+      flush();
+    }
+    data_[size_++] = c;
+  }
+
+  // Appends the decimal representation of `n`.
+  void append(unsigned int n) noexcept { append(std::uint64_t{n}); }
+
+  // Appends the decimal representation of `n`, right-aligned to `width`
+  // columns with leading spaces.
+  void append(std::uint64_t n, std::size_t width = 0) noexcept {
+    char digits[20];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    do {
+      *--p = static_cast<char>('0' + n % 10);
+      n /= 10;
+    } while (n != 0);
+    for (std::size_t len = end - p; len < width; ++len) {
+      append(' ');
+    }
+    append(std::string_view(p, end - p));
+  }
+
+  bool flush() noexcept {
+    if (size_ != 0) {
+      write_all(data_.data(), size_);
+      size_ = 0;
+    }
+    return !failed_;
+  }
+
+  bool failed() const noexcept { return failed_; }
+
+ private:
+  void write_all(const char* p, std::size_t n) noexcept {
+    if (!failed_) {
+      failed_ = !httpcode::write_all(fd_, std::string_view(p, n));
+    }
+  }
+
+  int fd_;
+  bool failed_ = false;
+  std::size_t size_ = 0;
+  std::array<char, capacity> data_;
+};
+
+// Gathers slices of memory that outlives it, such as a mapped file, and
+// writes them with writev(2) instead of copying them. Adjacent slices are
+// joined into one. The slices must stay valid until `flush`.
+class slice_writer {
+ public:
+  // IOV_MAX on Linux.
+  static constexpr std::size_t capacity = 1024;
+
+  explicit slice_writer(int fd) noexcept : fd_(fd) {}
+  slice_writer(const slice_writer&) = delete;
+  slice_writer& operator=(const slice_writer&) = delete;
+  ~slice_writer() { flush(); }
+
+  void add(std::string_view s) noexcept {
+    if (s.empty()) {
+      return;
+    }
+    if (count_ != 0) {
+      iovec& last = iov_[count_ - 1];
+      if (static_cast<const char*>(last.iov_base) + last.iov_len == s.data()) {
+        last.iov_len += s.size();
+        return;
+      }
+    }
+    if (count_ == capacity) {
+      flush();
+    }
+    iov_[count_++] = {const_cast<char*>(s.data()), s.size()};
+  }
+
+  bool flush() noexcept {
+    iovec* iov = iov_.data();
+    std::size_t count = count_;
+    count_ = 0;
+    const stats::scoped_timer timer(stats::stage::write);
+    while (count != 0 && !failed_) {
+      const ssize_t written = ::writev(fd_, iov, static_cast<int>(count));
+      stats::add(stats::counter::write_calls);
+      if (written < 0) {
+        failed_ = errno != EINTR;
+        continue;
+      }
+      stats::add(stats::counter::bytes_written,
+                 static_cast<std::size_t>(written));
+      // Skip what was written, which may end within a slice.
+      auto left = static_cast<std::size_t>(written);
+      while (count != 0 && left >= iov->iov_len) {
+        left -= iov->iov_len;
+        ++iov;
+        --count;
+      }
+      if (count != 0) {
+        iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+        iov->iov_len -= left;
+      }
+    }
+    return !failed_;
+  }
+
+ private:
+  int fd_;
+  bool failed_ = false;
+  std::size_t count_ = 0;
+  std::array<iovec, capacity> iov_;
+};
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_OUTPUT_BUFFER_HPP_
@@ -0,0 +1,331 @@
+#include "registry.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "stats.hpp"
+
+namespace httpcode {
+
+namespace {
+
+/// Registry source parser
+//
+// Accepts the subset of TOML that registries need: `[<code>]` table headers,
+// `key = "string"` pairs with basic or literal single-line strings, comments
+// and blank lines.
+
+struct source_entry {
+  unsigned int code = 0;
+  std::size_t line = 0;
+  std::optional<std::string> fields[3];
+};
+
+constexpr std::string_view field_names[] = {"short", "long", "url"};
+
+std::invalid_argument source_error(std::size_t line, std::string_view message) {
+  std::string what = "line ";
+  what += std::to_string(line);
+  what += ": ";
+  what += message;
+  return std::invalid_argument(what);
+}
+
+void skip_space(std::string_view& s) noexcept {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+}
+
+// Returns whether only whitespace and an optional comment remain in `s`.
+bool at_line_end(std::string_view s) noexcept {
+  skip_space(s);
+  return s.empty() || s.front() == '#';
+}
+
+void append_utf8(std::string& out, std::uint32_t cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xc0 | cp >> 6);
+    out += static_cast<char>(0x80 | (cp & 0x3f));
+  } else if (cp < 0x10000) {
+    out += static_cast<char>(0xe0 | cp >> 12);
+    out += static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+    out += static_cast<char>(0x80 | (cp & 0x3f));
+  } else {
+    out += static_cast<char>(0xf0 | cp >> 18);
+    out += static_cast<char>(0x80 | (cp >> 12 & 0x3f));
+    out += static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+    out += static_cast<char>(0x80 | (cp & 0x3f));
+  }
+}
+
+// Parses a basic ("...") or literal ('...') string from the front of `s`.
+tl::expected<std::string, std::string_view> parse_string(std::string_view& s) {
+  if (s.empty() || (s.front() != '"' && s.front() != '\'')) {
+    return tl::make_unexpected("expected a string");
+  }
+  const char quote = s.front();
+  s.remove_prefix(1);
+  std::string value;
+  while (!s.empty() && s.front() != quote) {
+    if (quote == '\'' || s.front() != '\\') {
+      value += s.front();
+      s.remove_prefix(1);
+      continue;
+    }
+    if (s.size() < 2) break;
+    const char escape = s[1];
+    s.remove_prefix(2);
+    switch (escape) {
+      case '"': value += '"'; break;
+      case '\\': value += '\\'; break;
+      case 'b': value += '\b'; break;
+      case 'f': value += '\f'; break;
+      case 'n': value += '\n'; break;
+      case 'r': value += '\r'; break;
+      case 't': value += '\t'; break;
+      case 'u':
+      case 'U': {
+        const std::size_t digits = escape == 'u' ? 4 : 8;
+        std::uint32_t cp = 0;
+        const auto [end, ec] =
+            std::from_chars(s.data(), s.data() + std::min(digits, s.size()),
+                            cp, 16);
+        if (ec != std::errc() || end != s.data() + digits || cp > 0x10ffff ||
+            (cp >= 0xd800 && cp <= 0xdfff)) {
+          return tl::make_unexpected("invalid unicode escape");
+        }
+        append_utf8(value, cp);
+        s.remove_prefix(digits);
+        break;
+      }
+      default:
+        return tl::make_unexpected("invalid escape sequence");
+    }
+  }
+  if (s.empty()) {
+    return tl::make_unexpected("unterminated string");
+  }
+  s.remove_prefix(1);
+  return value;
+}
+
+tl::expected<std::vector<source_entry>, std::invalid_argument> parse_source(
+    std::string_view source) {
+  std::vector<source_entry> entries;
+  std::size_t line_number = 0;
+  while (!source.empty()) {
+    ++line_number;
+    const std::size_t nl = source.find('\n');
+    std::string_view line = source.substr(0, nl);
+    source.remove_prefix(nl == std::string_view::npos ? source.size() : nl + 1);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+    skip_space(line);
+    if (at_line_end(line)) {
+      continue;
+    }
+
+    if (line.front() == '[') {
+      line.remove_prefix(1);
+      skip_space(line);
+      unsigned int code = 0;
+      const auto [end, ec] =
+          std::from_chars(line.data(), line.data() + line.size(), code);
+      const std::size_t digits = end - line.data();
+      line.remove_prefix(digits);
+      skip_space(line);
+      if (ec != std::errc() || digits != 3 || line.empty() ||
+          line.front() != ']' || !at_line_end(line.substr(1))) {
+        return tl::make_unexpected(
+            source_error(line_number, "expected a table header like [520]"));
+      }
+      const auto duplicate =
+          std::find_if(entries.begin(), entries.end(),
+                       [&](const source_entry& e) { return e.code == code; });
+      if (duplicate != entries.end()) {
+        return tl::make_unexpected(source_error(
+            line_number, "code is already defined on line " +
+                             std::to_string(duplicate->line)));
+      }
+      entries.push_back({code, line_number, {}});
+      continue;
+    }
+
+    const std::size_t key_len = std::min(line.find_first_of(" \t="),
+                                         line.size());
+    const std::string_view key = line.substr(0, key_len);
+    line.remove_prefix(key_len);
+    const auto field = std::find(std::begin(field_names),
+                                 std::end(field_names), key);
+    if (field == std::end(field_names)) {
+      return tl::make_unexpected(source_error(
+          line_number, "unknown key, expected short, long or url"));
+    }
+    if (entries.empty()) {
+      return tl::make_unexpected(
+          source_error(line_number, "key outside of a [<code>] table"));
+    }
+    skip_space(line);
+    if (line.empty() || line.front() != '=') {
+      return tl::make_unexpected(source_error(line_number, "expected '='"));
+    }
+    line.remove_prefix(1);
+    skip_space(line);
+    auto value = parse_string(line);
+    if (!value.has_value()) {
+      return tl::make_unexpected(source_error(line_number, value.error()));
+    }
+    if (!at_line_end(line)) {
+      return tl::make_unexpected(
+          source_error(line_number, "unexpected text after the value"));
+    }
+
+    auto& slot = entries.back().fields[field - std::begin(field_names)];
+    if (slot.has_value()) {
+      return tl::make_unexpected(source_error(line_number, "duplicate key"));
+    }
+    if (value->empty()) {
+      return tl::make_unexpected(source_error(line_number, "empty value"));
+    }
+    if (value->size() > std::numeric_limits<std::uint16_t>::max()) {
+      return tl::make_unexpected(source_error(line_number, "value too long"));
+    }
+    if (key != "long" && value->find_first_of("\r\n") != std::string::npos) {
+      return tl::make_unexpected(
+          source_error(line_number, "value must be a single line"));
+    }
+    slot = std::move(*value);
+  }
+
+  for (const source_entry& entry : entries) {
+    for (std::size_t i = 0; i < std::size(field_names); ++i) {
+      if (!entry.fields[i].has_value()) {
+        std::string message = "missing key '";
+        message += field_names[i];
+        message += '\'';
+        return tl::make_unexpected(source_error(entry.line, message));
+      }
+    }
+  }
+  return entries;
+}
+
+std::runtime_error open_error(const char* path, std::string_view reason) {
+  std::string what = "Cannot load registry '";
+  what += path;
+  what += "': ";
+  what += reason;
+  return std::runtime_error(what);
+}
+
+}  // namespace
+
+tl::expected<registry, std::runtime_error> registry::open(const char* path) {
+  auto file = mapped_file::open(path);
+  if (!file.has_value()) {
+    return tl::make_unexpected(open_error(path, file.error().message()));
+  }
+  const std::string_view data = file->view();
+  registry_header header;
+  if (data.size() < sizeof(header)) {
+    return tl::make_unexpected(open_error(path, "not a registry file"));
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != registry_magic) {
+    return tl::make_unexpected(open_error(path, "not a registry file"));
+  }
+  if (header.version != registry_version ||
+      header.byte_order != registry_byte_order) {
+    return tl::make_unexpected(
+        open_error(path, "unsupported registry version or byte order"));
+  }
+  const std::size_t entries_size =
+      std::size_t{header.count} * sizeof(registry_entry);
+  if (data.size() != sizeof(header) + entries_size + header.strings_size) {
+    return tl::make_unexpected(open_error(path, "truncated registry file"));
+  }
+
+  // The mapping is page-aligned and the header size is a multiple of the
+  // entry alignment, so the entries can be read where they are.
+  registry r;
+  r.entries_ = {
+      reinterpret_cast<const registry_entry*>(data.data() + sizeof(header)),
+      header.count};
+  r.strings_ = data.substr(sizeof(header) + entries_size);
+  long prev = -1;
+  for (const registry_entry& e : r.entries_) {
+    if (e.code <= prev || e.code > registry_max_code || e.short_len == 0 ||
+        std::size_t{e.offset} + e.short_len + e.long_len + e.url_len >
+            r.strings_.size()) {
+      return tl::make_unexpected(open_error(path, "corrupt entry table"));
+    }
+    prev = e.code;
+  }
+  r.file_ = std::move(*file);
+  return r;
+}
+
+std::optional<description> registry::find(long code) const noexcept {
+  const stats::scoped_timer timer(stats::stage::lookup);
+  const auto it = std::lower_bound(
+      entries_.begin(), entries_.end(), code,
+      [](const registry_entry& e, long c) { return e.code < c; });
+  if (it == entries_.end() || it->code != code) {
+    return find_code(code);
+  }
+  return description{
+      strings_.substr(it->offset, it->short_len),
+      strings_.substr(it->offset + it->short_len, it->long_len),
+      strings_.substr(it->offset + it->short_len + it->long_len, it->url_len)};
+}
+
+tl::expected<std::string, std::invalid_argument> compile_registry(
+    std::string_view source) {
+  auto entries = parse_source(source);
+  if (!entries.has_value()) {
+    return tl::make_unexpected(std::move(entries.error()));
+  }
+  std::sort(entries->begin(), entries->end(),
+            [](const source_entry& a, const source_entry& b) {
+              return a.code < b.code;
+            });
+
+  std::vector<registry_entry> table;
+  std::string strings;
+  for (const source_entry& entry : *entries) {
+    const auto& [short_desc, long_desc, url] = entry.fields;
+    table.push_back({static_cast<std::uint16_t>(entry.code),
+                     static_cast<std::uint16_t>(short_desc->size()),
+                     static_cast<std::uint16_t>(long_desc->size()),
+                     static_cast<std::uint16_t>(url->size()),
+                     static_cast<std::uint32_t>(strings.size())});
+    strings += *short_desc;
+    strings += *long_desc;
+    strings += *url;
+  }
+
+  const registry_header header{registry_magic, registry_version,
+                               registry_byte_order,
+                               static_cast<std::uint32_t>(table.size()),
+                               static_cast<std::uint32_t>(strings.size())};
+  std::string image(sizeof(header) + table.size() * sizeof(registry_entry) +
+                        strings.size(),
+                    '\0');
+  char* out = image.data();
+  std::memcpy(out, &header, sizeof(header));
+  out += sizeof(header);
+  std::memcpy(out, table.data(), table.size() * sizeof(registry_entry));
+  out += table.size() * sizeof(registry_entry);
+  std::memcpy(out, strings.data(), strings.size());
+  return image;
+}
+
+}  // namespace httpcode
@@ -0,0 +1,94 @@
+#ifndef HTTPCODE_REGISTRY_HPP_
+#define HTTPCODE_REGISTRY_HPP_
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tl/expected.hpp>
+
+#include "httpcode/codes.hpp"
+#include "mapped_file.hpp"
+
+namespace httpcode {
+
+/// Custom status registries
+//
+// A registry adds codes to the built-in table or replaces their descriptions.
+// It is written in TOML, one table per code:
+//
+//   [520]
+//   short = "Web Server Returned an Unknown Error"
+//   long = "The origin server returned an empty or unexpected response."
+//   url = "https://developers.cloudflare.com/support/troubleshooting/..."
+//
+// and compiled by `httpcode compile-registry` into a flat file that is mapped
+// and used in place:
+//
+//   registry_header
+//   registry_entry[count]    sorted by code
+//   char[strings_size]       descriptions, referenced by offset
+//
+// Integers are stored in native byte order, which `byte_order` records. Codes
+// are any three digits, 000 to 999, not only those of the built-in categories.
+
+inline constexpr std::array<char, 8> registry_magic = {'H', 'T', 'T', 'P',
+                                                       'C', 'R', 'E', 'G'};
+inline constexpr std::uint32_t registry_version = 1;
+inline constexpr std::uint32_t registry_byte_order = 0x01020304;
+inline constexpr unsigned int registry_max_code = 999;
+
+struct registry_header {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint32_t count;
+  std::uint32_t strings_size;
+};
+
+// Same layout as `code_slot`, keyed by code.
+struct registry_entry {
+  std::uint16_t code;
+  std::uint16_t short_len;
+  std::uint16_t long_len;
+  std::uint16_t url_len;
+  std::uint32_t offset;
+};
+
+static_assert(sizeof(registry_header) == 24);
+static_assert(sizeof(registry_entry) == 12);
+static_assert(sizeof(registry_header) % alignof(registry_entry) == 0);
+
+// The built-in status code table with an optional registry file overlaid. A
+// default-constructed registry holds only the built-in codes.
+class registry {
+ public:
+  registry() noexcept = default;
+
+  // Maps a compiled registry file. Only the header and the entry bounds are
+  // checked; nothing is copied.
+  static tl::expected<registry, std::runtime_error> open(const char* path);
+
+  // Returns the description of `code` from the registry file if it has one,
+  // and from the built-in table otherwise.
+  std::optional<description> find(long code) const noexcept;
+
+  std::size_t size() const noexcept { return entries_.size(); }
+
+ private:
+  mapped_file file_;
+  std::span<const registry_entry> entries_;
+  std::string_view strings_;
+};
+
+// Compiles the TOML source of a registry into the binary format above. Errors
+// name the offending line.
+tl::expected<std::string, std::invalid_argument> compile_registry(
+    std::string_view source);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_REGISTRY_HPP_
@@ -0,0 +1,176 @@
+#ifndef HTTPCODE_RENDERED_HPP_
+#define HTTPCODE_RENDERED_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "httpcode/codes.hpp"
+
+namespace httpcode {
+
+/// Pre-rendered output
+//
+// Everything `httpcode <code>`, `httpcode list` and `httpcode list <category>`
+// can print depends only on the status code table, so all of it is rendered
+// during constant evaluation into one static blob.
+
+namespace detail {
+
+inline constexpr std::string_view list_heading =
+    "-----------------\n"
+    "HTTP Status Codes\n"
+    "-----------------\n";
+
+// Appends rendered text to `out`, or only counts it while `out` is null.
+struct render_sink {
+  char* out = nullptr;
+  std::size_t size = 0;
+
+  constexpr void put(std::string_view s) noexcept {
+    if (out != nullptr) {
+      for (const char c : s) out[size++] = c;
+    } else {
+      size += s.size();
+    }
+  }
+
+  constexpr void put(unsigned int code) noexcept {
+    const char digits[] = {static_cast<char>('0' + code / 100),
+                           static_cast<char>('0' + code / 10 % 10),
+                           static_cast<char>('0' + code % 10)};
+    put(std::string_view(digits, 3));
+  }
+};
+
+struct rendered_span {
+  std::uint32_t offset = 0;
+  std::uint32_t size = 0;
+};
+
+struct rendered_index {
+  std::array<rendered_span, max_code - min_code + 1> codes{};
+  std::array<rendered_span, std::size(categories)> category_lists{};
+  rendered_span list;
+};
+
+// Renders every output into `sink` and returns where each one starts.
+constexpr rendered_index render_all(render_sink& sink) noexcept {
+  rendered_index index;
+  const auto begin = [&] { return static_cast<std::uint32_t>(sink.size); };
+  const auto end = [&](rendered_span& span, std::uint32_t start) {
+    span = {start, static_cast<std::uint32_t>(sink.size) - start};
+  };
+  const auto put_entry = [&](unsigned int code, const description& desc) {
+    sink.put(code);
+    sink.put(" ");
+    sink.put(std::get<0>(desc));
+    sink.put("\n");
+  };
+
+  for (const auto& [code, desc] : code_entries) {
+    const auto& [short_desc, long_desc, url] = desc;
+    const std::uint32_t start = begin();
+    sink.put(code);
+    sink.put(" ");
+    sink.put(short_desc);
+    sink.put("\n");
+    sink.put(long_desc);
+    sink.put("\n\nLearn more: ");
+    sink.put(url);
+    sink.put("\n");
+    end(index.codes[code - min_code], start);
+  }
+
+  std::uint32_t start = begin();
+  sink.put(list_heading);
+  for (const auto& [code, desc] : code_entries) {
+    put_entry(code, desc);
+  }
+  end(index.list, start);
+
+  for (std::size_t i = 0; i < std::size(categories); ++i) {
+    start = begin();
+    sink.put(categories[i].heading);
+    for (const auto& [code, desc] : code_entries) {
+      if (code >= categories[i].first_code && code <= categories[i].last_code) {
+        put_entry(code, desc);
+      }
+    }
+    end(index.category_lists[i], start);
+  }
+  return index;
+}
+
+inline constexpr std::size_t rendered_size = [] {
+  render_sink sink;
+  render_all(sink);
+  return sink.size;
+}();
+
+inline constexpr std::array<char, rendered_size> rendered_blob = [] {
+  std::array<char, rendered_size> blob{};
+  render_sink sink{blob.data()};
+  render_all(sink);
+  return blob;
+}();
+
+inline constexpr rendered_index rendered = [] {
+  render_sink sink;
+  return render_all(sink);
+}();
+
+constexpr std::string_view rendered_view(rendered_span span) noexcept {
+  return std::string_view(rendered_blob.data() + span.offset, span.size);
+}
+
+}  // namespace detail
+
+// Returns what `httpcode <code>` prints, or nothing if the code is unknown.
+constexpr std::optional<std::string_view> rendered_code(long code) noexcept {
+  if (code < min_code || code > max_code) {
+    return std::nullopt;
+  }
+  const auto span = detail::rendered.codes[code - min_code];
+  if (span.size == 0) {
+    return std::nullopt;
+  }
+  return detail::rendered_view(span);
+}
+
+// Returns what `httpcode list` prints.
+constexpr std::string_view rendered_list() noexcept {
+  return detail::rendered_view(detail::rendered.list);
+}
+
+// Returns what `httpcode list <c.name>` prints.
+constexpr std::string_view rendered_category(const category& c) noexcept {
+  return detail::rendered_view(detail::rendered.category_lists[&c - categories]);
+}
+
+static_assert(*rendered_code(200) ==
+              "200 OK\n"
+              "The request has succeeded.\n"
+              "\n"
+              "Learn more: https://httpstatuses.io/200\n");
+static_assert(!rendered_code(306).has_value());
+static_assert(rendered_list().starts_with(
+    "-----------------\n"
+    "HTTP Status Codes\n"
+    "-----------------\n"
+    "100 Continue\n"));
+static_assert(rendered_list().ends_with("599 Network Connect Timeout Error\n"));
+static_assert(rendered_category(categories[0]) ==
+              "-----------------\n"
+              "1xx Informational\n"
+              "-----------------\n"
+              "100 Continue\n"
+              "101 Switching Protocols\n"
+              "102 Processing\n"
+              "103 Early Hints\n");
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_RENDERED_HPP_
@@ -0,0 +1,277 @@
+#ifndef HTTPCODE_SEARCH_HPP_
+#define HTTPCODE_SEARCH_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "httpcode/codes.hpp"
+
+namespace httpcode {
+
+/// Full-text search
+//
+// An inverted index over the short and long descriptions of `code_entries`,
+// built during constant evaluation. Terms are runs of ASCII letters and digits,
+// compared case-insensitively. Every term has a posting list of the entries
+// that contain it, sorted by entry, with a weight that counts occurrences in
+// the short description `short_weight` times.
+
+namespace detail {
+
+static_assert(std::size(code_entries) <= 256, "entries are stored as uint8");
+
+inline constexpr unsigned int short_weight = 4;
+
+// Longest term that can be looked up; longer query terms match nothing.
+inline constexpr std::size_t max_term_size = 32;
+
+constexpr bool is_term_char(char c) noexcept {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+         (c >= 'A' && c <= 'Z');
+}
+
+constexpr char fold_case(char c) noexcept {
+  return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// Calls `fn` with every term in `text`, in its original case.
+template <typename Fn>
+constexpr void for_each_term(std::string_view text, Fn&& fn) {
+  std::size_t i = 0;
+  while (i < text.size()) {
+    while (i < text.size() && !is_term_char(text[i])) ++i;
+    const std::size_t start = i;
+    while (i < text.size() && is_term_char(text[i])) ++i;
+    if (i > start) fn(text.substr(start, i - start));
+  }
+}
+
+// Orders terms as their lower-case forms would be ordered.
+constexpr bool folded_less(std::string_view a, std::string_view b) noexcept {
+  const std::size_t n = std::min(a.size(), b.size());
+  for (std::size_t i = 0; i < n; ++i) {
+    if (fold_case(a[i]) != fold_case(b[i])) {
+      return fold_case(a[i]) < fold_case(b[i]);
+    }
+  }
+  return a.size() < b.size();
+}
+
+struct search_term {
+  std::uint16_t text_offset;
+  std::uint8_t text_size;
+  std::uint16_t first_posting;
+  std::uint16_t posting_count;
+};
+
+struct posting {
+  std::uint8_t entry;
+  std::uint8_t weight;
+};
+
+struct search_index_sizes {
+  std::size_t terms = 0;
+  std::size_t postings = 0;
+  std::size_t text = 0;
+};
+
+// Builds the index into the given arrays, or only measures it while they are
+// null, and returns its size.
+constexpr search_index_sizes build_search_index(search_term* terms,
+                                                posting* postings,
+                                                char* text) {
+  struct occurrence {
+    std::string_view term;
+    std::uint8_t entry;
+    std::uint8_t weight;
+  };
+  std::vector<occurrence> occurrences;
+  for (std::size_t i = 0; i < std::size(code_entries); ++i) {
+    const auto& [short_desc, long_desc, _] = code_entries[i].second;
+    const auto entry = static_cast<std::uint8_t>(i);
+    for_each_term(short_desc, [&](std::string_view term) {
+      occurrences.push_back({term, entry, short_weight});
+    });
+    for_each_term(long_desc, [&](std::string_view term) {
+      occurrences.push_back({term, entry, 1});
+    });
+  }
+  std::sort(occurrences.begin(), occurrences.end(),
+            [](const occurrence& a, const occurrence& b) {
+              if (folded_less(a.term, b.term)) return true;
+              if (folded_less(b.term, a.term)) return false;
+              return a.entry < b.entry;
+            });
+
+  search_index_sizes sizes;
+  for (std::size_t i = 0; i < occurrences.size(); ++i) {
+    const occurrence& o = occurrences[i];
+    const bool new_term =
+        i == 0 || folded_less(occurrences[i - 1].term, o.term);
+    if (new_term) {
+      if (terms != nullptr) {
+        terms[sizes.terms] = {static_cast<std::uint16_t>(sizes.text),
+                              static_cast<std::uint8_t>(o.term.size()),
+                              static_cast<std::uint16_t>(sizes.postings), 0};
+        for (std::size_t j = 0; j < o.term.size(); ++j) {
+          text[sizes.text + j] = fold_case(o.term[j]);
+        }
+      }
+      ++sizes.terms;
+      sizes.text += o.term.size();
+    }
+    if (new_term || occurrences[i - 1].entry != o.entry) {
+      if (terms != nullptr) {
+        postings[sizes.postings] = {o.entry, 0};
+        ++terms[sizes.terms - 1].posting_count;
+      }
+      ++sizes.postings;
+    }
+    if (terms != nullptr) {
+      postings[sizes.postings - 1].weight += o.weight;
+    }
+  }
+  return sizes;
+}
+
+inline constexpr search_index_sizes search_sizes =
+    build_search_index(nullptr, nullptr, nullptr);
+
+struct search_index {
+  std::array<search_term, search_sizes.terms> terms{};
+  std::array<posting, search_sizes.postings> postings{};
+  std::array<char, search_sizes.text> text{};
+
+  constexpr std::string_view term_text(const search_term& t) const noexcept {
+    return std::string_view(text.data() + t.text_offset, t.text_size);
+  }
+};
+
+inline constexpr search_index index = [] {
+  search_index idx;
+  build_search_index(idx.terms.data(), idx.postings.data(), idx.text.data());
+  return idx;
+}();
+
+static_assert(search_sizes.text < 65536 && search_sizes.postings < 65536);
+static_assert([] {
+  for (const search_term& t : index.terms) {
+    if (t.text_size > max_term_size) return false;
+  }
+  return true;
+}(), "raise max_term_size");
+
+// Returns the posting list of `term`, which is empty if the term is unknown.
+constexpr std::span<const posting> find_postings(
+    std::string_view term) noexcept {
+  if (term.size() > max_term_size) {
+    return {};
+  }
+  const auto it = std::lower_bound(
+      index.terms.begin(), index.terms.end(), term,
+      [](const search_term& t, std::string_view s) {
+        return folded_less(index.term_text(t), s);
+      });
+  if (it == index.terms.end() || folded_less(term, index.term_text(*it))) {
+    return {};
+  }
+  return std::span(index.postings).subspan(it->first_posting,
+                                           it->posting_count);
+}
+
+}  // namespace detail
+
+struct search_hit {
+  unsigned int code;
+  unsigned int score;
+};
+
+// Queries with more terms than this ignore the rest.
+inline constexpr std::size_t max_search_terms = 16;
+
+using search_results = std::array<search_hit, std::size(code_entries)>;
+
+// Finds the codes whose descriptions contain every term in `query`, writes
+// them to `hits` ranked by score (and then by code), and returns how many
+// there are. Each element of `query` may hold several terms.
+constexpr std::size_t search(std::span<const std::string_view> query,
+                             search_results& hits) noexcept {
+  std::array<std::span<const detail::posting>, max_search_terms> lists{};
+  std::size_t list_count = 0;
+  bool missing = false;
+  for (const std::string_view arg : query) {
+    detail::for_each_term(arg, [&](std::string_view term) {
+      if (list_count == lists.size()) return;
+      lists[list_count] = detail::find_postings(term);
+      missing = missing || lists[list_count].empty();
+      ++list_count;
+    });
+  }
+  if (list_count == 0 || missing) {
+    return 0;
+  }
+
+  // Intersect starting from the shortest list; every other list is searched
+  // from where the previous candidate was found.
+  std::sort(lists.begin(), lists.begin() + list_count,
+            [](const auto& a, const auto& b) { return a.size() < b.size(); });
+  std::array<std::size_t, max_search_terms> cursors{};
+  std::size_t count = 0;
+  for (const detail::posting& candidate : lists[0]) {
+    unsigned int score = candidate.weight;
+    bool found = true;
+    for (std::size_t i = 1; i < list_count && found; ++i) {
+      const auto rest = lists[i].subspan(cursors[i]);
+      const auto it = std::lower_bound(
+          rest.begin(), rest.end(), candidate.entry,
+          [](const detail::posting& p, std::uint8_t e) { return p.entry < e; });
+      cursors[i] += static_cast<std::size_t>(it - rest.begin());
+      found = it != rest.end() && it->entry == candidate.entry;
+      if (found) score += it->weight;
+    }
+    if (found) {
+      hits[count++] = {code_entries[candidate.entry].first, score};
+    }
+  }
+  std::sort(hits.begin(), hits.begin() + count,
+            [](const search_hit& a, const search_hit& b) {
+              return a.score != b.score ? a.score > b.score : a.code < b.code;
+            });
+  return count;
+}
+
+namespace detail {
+
+// Returns the ranked codes matching `query`, for the checks below.
+template <std::size_t N>
+constexpr std::array<unsigned int, N> top_codes(
+    std::initializer_list<std::string_view> query) {
+  search_results hits{};
+  const std::size_t count =
+      search(std::span(query.begin(), query.size()), hits);
+  std::array<unsigned int, N> codes{};
+  for (std::size_t i = 0; i < N && i < count; ++i) codes[i] = hits[i].code;
+  return codes;
+}
+
+}  // namespace detail
+
+static_assert(detail::top_codes<3>({"timeout"}) ==
+              std::array<unsigned int, 3>{599, 408, 504});
+static_assert(detail::top_codes<1>({"Gateway Timeout"})[0] == 504);
+static_assert(detail::top_codes<1>({"gateway", "TIMEOUT"})[0] == 504);
+static_assert(detail::top_codes<1>({"range"})[0] == 416);
+static_assert(detail::top_codes<2>({"proxy"}) ==
+              std::array<unsigned int, 2>{305, 407});
+static_assert(detail::top_codes<1>({"timeout", "nonexistent"})[0] == 0);
+static_assert(detail::top_codes<1>({"--"})[0] == 0);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_SEARCH_HPP_
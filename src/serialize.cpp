@@ -0,0 +1,360 @@
+#include "serialize.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+
+#include "stats.hpp"
+
+namespace httpcode {
+
+namespace {
+
+constexpr std::string_view invalid_input_error = "Invalid HTTP status code";
+
+template <typename T>
+void append_bytes(output_buffer& out, const T& value) noexcept {
+  out.append(std::string_view(reinterpret_cast<const char*>(&value),
+                              sizeof(value)));
+}
+
+constexpr bool needs_json_escape(unsigned char c) noexcept {
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+// Returns the position of the first character of `s` at or after `i` that
+// needs escaping in JSON, or `s.size()`. Eight characters are tested at a
+// time, since descriptions rarely contain any.
+std::size_t find_json_escape(std::string_view s, std::size_t i) noexcept {
+  constexpr std::uint64_t ones = 0x0101010101010101;
+  constexpr std::uint64_t highs = 0x8080808080808080;
+  for (; i + 8 <= s.size(); i += 8) {
+    std::uint64_t v;
+    std::memcpy(&v, s.data() + i, sizeof(v));
+    const auto has_zero = [](std::uint64_t x) {
+      return (x - ones) & ~x & highs;
+    };
+    const std::uint64_t control = (v - ones * 0x20) & ~v & highs;
+    if ((control | has_zero(v ^ (ones * '"')) |
+         has_zero(v ^ (ones * '\\'))) != 0) {
+      break;
+    }
+  }
+  while (i < s.size() &&
+         !needs_json_escape(static_cast<unsigned char>(s[i]))) {
+    ++i;
+  }
+  return i;
+}
+
+// Appends `s` as a JSON string, copying runs that need no escaping in one go.
+void append_json_string(output_buffer& out, std::string_view s) noexcept {
+  constexpr char hex[] = "0123456789abcdef";
+  out.append('"');
+  std::size_t start = 0;
+  for (std::size_t i = find_json_escape(s, 0); i < s.size();
+       i = find_json_escape(s, start)) {
+    const auto c = static_cast<unsigned char>(s[i]);
+    out.append(s.substr(start, i - start));
+    start = i + 1;
+    out.append('\\');
+    switch (c) {
+      case '"':
+      case '\\':
+        out.append(static_cast<char>(c));
+        break;
+      case '\n':
+        out.append('n');
+        break;
+      case '\r':
+        out.append('r');
+        break;
+      case '\t':
+        out.append('t');
+        break;
+      default:
+        out.append("u00");
+        out.append(hex[c >> 4]);
+        out.append(hex[c & 0xf]);
+    }
+  }
+  out.append(s.substr(start));
+  out.append('"');
+}
+
+// Appends `s` as a CSV field, quoted only if it has to be.
+void append_csv_field(output_buffer& out, std::string_view s) noexcept {
+  if (s.find_first_of(",\"\r\n") == std::string_view::npos) {
+    out.append(s);
+    return;
+  }
+  out.append('"');
+  std::size_t start = 0;
+  for (std::size_t quote = s.find('"'); quote != std::string_view::npos;
+       quote = s.find('"', start)) {
+    out.append(s.substr(start, quote + 1 - start));
+    out.append('"');
+    start = quote + 1;
+  }
+  out.append(s.substr(start));
+  out.append('"');
+}
+
+}  // namespace
+
+std::optional<output_format> find_output_format(
+    std::string_view name) noexcept {
+  if (name == "text") return output_format::text;
+  if (name == "json") return output_format::json;
+  if (name == "ndjson") return output_format::ndjson;
+  if (name == "csv") return output_format::csv;
+  if (name == "bin") return output_format::bin;
+  return std::nullopt;
+}
+
+record_writer::record_writer(output_buffer& out, output_format format,
+                             record_kind kind) noexcept
+    : out_(out), format_(format), kind_(kind) {
+  switch (format_) {
+    case output_format::json:
+      out_.append('[');
+      break;
+    case output_format::csv:
+      if (kind == record_kind::status) {
+        out_.append("code,short,long,url,error\n");
+        break;
+      }
+      out_.append("code,short,count");
+      if (kind == record_kind::latency) {
+        for (const std::string_view name : latency_quantile_names) {
+          out_.append(',');
+          out_.append(name);
+          out_.append("_us");
+        }
+      }
+      out_.append('\n');
+      break;
+    case output_format::bin: {
+      const std::uint32_t record_size = kind == record_kind::status
+                                            ? sizeof(status_record)
+                                        : kind == record_kind::count
+                                            ? sizeof(count_record)
+                                            : sizeof(latency_record);
+      append_bytes(out_, record_header{record_magic, record_version,
+                                       record_byte_order,
+                                       static_cast<std::uint32_t>(kind),
+                                       record_size});
+      break;
+    }
+    case output_format::text:
+    case output_format::ndjson:
+      break;
+  }
+}
+
+void record_writer::begin_object() noexcept {
+  if (format_ == output_format::json) {
+    out_.append(first_ ? "\n" : ",\n");
+  }
+  first_ = false;
+  out_.append('{');
+}
+
+void record_writer::end_object() noexcept {
+  out_.append(format_ == output_format::ndjson ? "}\n" : "}");
+}
+
+void record_writer::status(unsigned int code,
+                           const description& desc) noexcept {
+  const auto& [short_desc, long_desc, url] = desc;
+  switch (format_) {
+    case output_format::json:
+    case output_format::ndjson:
+      begin_object();
+      out_.append("\"code\":");
+      out_.append(code);
+      out_.append(",\"short\":");
+      append_json_string(out_, short_desc);
+      out_.append(",\"long\":");
+      append_json_string(out_, long_desc);
+      out_.append(",\"url\":");
+      append_json_string(out_, url);
+      end_object();
+      break;
+    case output_format::csv:
+      out_.append(code);
+      out_.append(',');
+      append_csv_field(out_, short_desc);
+      out_.append(',');
+      append_csv_field(out_, long_desc);
+      out_.append(',');
+      append_csv_field(out_, url);
+      out_.append(",\n");
+      break;
+    case output_format::bin:
+      append_bytes(out_, status_record{code, 0});
+      break;
+    case output_format::text:
+      break;
+  }
+}
+
+void record_writer::invalid(std::string_view input) noexcept {
+  switch (format_) {
+    case output_format::json:
+    case output_format::ndjson:
+      begin_object();
+      out_.append("\"input\":");
+      append_json_string(out_, input);
+      out_.append(",\"error\":");
+      append_json_string(out_, invalid_input_error);
+      end_object();
+      break;
+    case output_format::csv:
+      append_csv_field(out_, input);
+      out_.append(",,,,");
+      out_.append(invalid_input_error);
+      out_.append('\n');
+      break;
+    case output_format::bin:
+      append_bytes(out_, status_record{0, 0});
+      break;
+    case output_format::text:
+      break;
+  }
+}
+
+void record_writer::count(unsigned int code, const description* desc,
+                          std::uint64_t count,
+                          const latency_histogram* latency) noexcept {
+  const bool latencies = kind_ == record_kind::latency;
+  switch (format_) {
+    case output_format::json:
+    case output_format::ndjson:
+      begin_object();
+      out_.append("\"code\":");
+      out_.append(code);
+      out_.append(",\"short\":");
+      if (desc != nullptr) {
+        append_json_string(out_, std::get<0>(*desc));
+      } else {
+        out_.append("null");
+      }
+      out_.append(",\"count\":");
+      out_.append(count);
+      for (std::size_t i = 0; latencies && i < latency_quantiles.size(); ++i) {
+        out_.append(",\"");
+        out_.append(latency_quantile_names[i]);
+        out_.append("_us\":");
+        if (latency != nullptr) {
+          out_.append(latency->quantile(latency_quantiles[i]));
+        } else {
+          out_.append("null");
+        }
+      }
+      end_object();
+      break;
+    case output_format::csv:
+      out_.append(code);
+      out_.append(',');
+      if (desc != nullptr) {
+        append_csv_field(out_, std::get<0>(*desc));
+      }
+      out_.append(',');
+      out_.append(count);
+      for (std::size_t i = 0; latencies && i < latency_quantiles.size(); ++i) {
+        out_.append(',');
+        if (latency != nullptr) {
+          out_.append(latency->quantile(latency_quantiles[i]));
+        }
+      }
+      out_.append('\n');
+      break;
+    case output_format::bin:
+      if (latencies) {
+        latency_record record{code, 0, count, {}};
+        for (std::size_t i = 0; i < record.quantiles.size(); ++i) {
+          record.quantiles[i] =
+              latency != nullptr ? latency->quantile(latency_quantiles[i]) : 0;
+        }
+        append_bytes(out_, record);
+      } else {
+        append_bytes(out_, count_record{code, 0, count});
+      }
+      break;
+    case output_format::text:
+      break;
+  }
+}
+
+void record_writer::malformed(std::uint64_t count) noexcept {
+  switch (format_) {
+    case output_format::json:
+    case output_format::ndjson:
+      begin_object();
+      out_.append("\"code\":null,\"count\":");
+      out_.append(count);
+      end_object();
+      break;
+    case output_format::csv:
+      out_.append(",,");
+      out_.append(count);
+      if (kind_ == record_kind::latency) {
+        out_.append(std::string_view(",,,,", latency_quantiles.size()));
+      }
+      out_.append('\n');
+      break;
+    case output_format::bin:
+      if (kind_ == record_kind::latency) {
+        append_bytes(out_, latency_record{malformed_code, 0, count, {}});
+      } else {
+        append_bytes(out_, count_record{malformed_code, 0, count});
+      }
+      break;
+    case output_format::text:
+      break;
+  }
+}
+
+void record_writer::finish() noexcept {
+  if (format_ == output_format::json) {
+    out_.append(first_ ? "]\n" : "\n]\n");
+  }
+}
+
+void write_status_records(output_buffer& out, output_format format,
+                          const registry& names,
+                          const code_set& selected) noexcept {
+  const stats::scoped_timer timer(stats::stage::render);
+  record_writer writer(out, format, record_kind::status);
+  selected.for_each([&](unsigned int code) {
+    if (const auto desc = names.find(code)) {
+      writer.status(code, *desc);
+    }
+  });
+  writer.finish();
+}
+
+void write_count_records(output_buffer& out, output_format format,
+                         const status_counts& counts, const registry& names,
+                         const latency_counts* latencies) noexcept {
+  const stats::scoped_timer timer(stats::stage::render);
+  record_writer writer(
+      out, format,
+      latencies != nullptr ? record_kind::latency : record_kind::count);
+  for (unsigned int code = 0; code < counts.codes.size(); ++code) {
+    if (counts.codes[code] != 0) {
+      const auto desc = names.find(code);
+      writer.count(code, desc.has_value() ? &*desc : nullptr,
+                   counts.codes[code],
+                   latencies != nullptr ? latencies->codes[code].get()
+                                        : nullptr);
+    }
+  }
+  if (counts.malformed != 0) {
+    writer.malformed(counts.malformed);
+  }
+  writer.finish();
+}
+
+}  // namespace httpcode
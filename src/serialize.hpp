@@ -0,0 +1,149 @@
+#ifndef HTTPCODE_SERIALIZE_HPP_
+#define HTTPCODE_SERIALIZE_HPP_
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "code_set.hpp"
+#include "httpcode/codes.hpp"
+#include "latency.hpp"
+#include "log_scan.hpp"
+#include "output_buffer.hpp"
+#include "registry.hpp"
+
+namespace httpcode {
+
+/// Machine-readable output
+//
+// Every command that prints descriptions or counters can print them as
+// records instead, in one of these formats:
+//
+//   json     a single array of objects
+//   ndjson   one object per line
+//   csv      a header line, then one row per record (RFC 4180 quoting)
+//   bin      a record_header, then fixed-width records
+//
+// There are two kinds of records. Status records describe a code:
+//
+//   {"code":404,"short":"Not Found","long":"...","url":"..."}
+//
+// or, for batch input that is not a known code, the offending input:
+//
+//   {"input":"abc","error":"Invalid HTTP status code"}
+//
+// and count records hold a status code counter of a log analysis, where lines
+// without a status field are counted under a null code:
+//
+//   {"code":404,"short":"Not Found","count":12}
+//   {"code":null,"count":3}
+//
+// When request times were analyzed too, count records also hold the
+// `latency_quantiles` of each code in microseconds, or null if no line with
+// that code had a request time:
+//
+//   {"code":504,"short":"Gateway Timeout","count":2,"p50_us":30015,...}
+//
+// The binary format leaves out all text, so that every record has the same
+// size and a whole output can be mapped and read as an array. Descriptions can
+// be looked up with the library (see httpcode/status.hpp). Integers are stored
+// in native byte order, which `byte_order` records.
+
+enum class output_format { text, json, ndjson, csv, bin };
+
+// Returns the format with the given name, or nothing if there is none.
+std::optional<output_format> find_output_format(std::string_view name) noexcept;
+
+enum class record_kind : std::uint32_t { status = 1, count = 2, latency = 3 };
+
+inline constexpr std::array<char, 8> record_magic = {'H', 'T', 'T', 'P',
+                                                     'C', 'R', 'E', 'C'};
+inline constexpr std::uint32_t record_version = 1;
+inline constexpr std::uint32_t record_byte_order = 0x01020304;
+
+struct record_header {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  // A `record_kind`.
+  std::uint32_t kind;
+  std::uint32_t record_size;
+};
+
+struct status_record {
+  // Zero for input that is not a known status code.
+  std::uint32_t code;
+  std::uint32_t reserved;
+};
+
+// Code used for lines without a status field.
+inline constexpr std::uint32_t malformed_code = 0xffffffff;
+
+struct count_record {
+  std::uint32_t code;
+  std::uint32_t reserved;
+  std::uint64_t count;
+};
+
+// A count record followed by the `latency_quantiles` of the code, all 0 if no
+// line with the code had a request time.
+struct latency_record {
+  std::uint32_t code;
+  std::uint32_t reserved;
+  std::uint64_t count;
+  std::array<std::uint64_t, latency_quantiles.size()> quantiles;
+};
+
+static_assert(sizeof(record_header) == 24);
+static_assert(sizeof(status_record) == 8);
+static_assert(sizeof(count_record) == 16);
+static_assert(sizeof(latency_record) == 48);
+static_assert(sizeof(record_header) % alignof(count_record) == 0);
+
+// Writes a stream of records of one kind to `out`, escaping text on the way.
+// It never allocates. `finish` must be called after the last record.
+class record_writer {
+ public:
+  // Writes the start of the stream. `format` must not be `text`.
+  record_writer(output_buffer& out, output_format format,
+                record_kind kind) noexcept;
+  record_writer(const record_writer&) = delete;
+  record_writer& operator=(const record_writer&) = delete;
+
+  void status(unsigned int code, const description& desc) noexcept;
+  void invalid(std::string_view input) noexcept;
+  // `desc` is null for codes that are not in the table, and `latency` for
+  // codes without request times. Latencies are only written by streams of
+  // `record_kind::latency`.
+  void count(unsigned int code, const description* desc, std::uint64_t count,
+             const latency_histogram* latency = nullptr) noexcept;
+  void malformed(std::uint64_t count) noexcept;
+
+  void finish() noexcept;
+
+ private:
+  void begin_object() noexcept;
+  void end_object() noexcept;
+
+  output_buffer& out_;
+  output_format format_;
+  record_kind kind_;
+  bool first_ = true;
+};
+
+// Writes every code of `names` in `selected` as status records.
+void write_status_records(output_buffer& out, output_format format,
+                          const registry& names,
+                          const code_set& selected) noexcept;
+
+// Writes the non-zero counters of `counts` in ascending order of code, then
+// the lines without a status field. With `latencies`, the records are of
+// `record_kind::latency`.
+void write_count_records(output_buffer& out, output_format format,
+                         const status_counts& counts, const registry& names,
+                         const latency_counts* latencies = nullptr) noexcept;
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_SERIALIZE_HPP_
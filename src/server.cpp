@@ -0,0 +1,335 @@
+#include "server.hpp"
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "format.hpp"
+
+namespace httpcode {
+
+namespace {
+
+std::error_code last_error() noexcept {
+  return std::error_code(errno, std::generic_category());
+}
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+extern "C" void request_stop(int) { stop_requested = 1; }
+
+// Largest request line accepted; anything longer is rejected and the
+// connection is closed.
+constexpr std::size_t max_request_size = 4096;
+
+// A connection stops reading new requests while this many responses are
+// waiting to be sent, which bounds the memory a client that pipelines without
+// reading can pin.
+constexpr std::size_t max_pending_responses = 1024;
+
+struct connection {
+  int fd;
+  std::uint32_t events = EPOLLIN;
+  bool eof = false;
+  std::size_t input_size = 0;
+  std::array<char, max_request_size> input;
+  // Responses not yet written. They point into the response table, so queuing
+  // one is just recording its address.
+  std::vector<iovec> output;
+  std::size_t output_head = 0;
+};
+
+// Writes as much pending output as the socket accepts. Returns false if the
+// connection failed.
+bool flush(connection& conn) noexcept {
+  while (conn.output_head < conn.output.size()) {
+    msghdr msg{};
+    msg.msg_iov = conn.output.data() + conn.output_head;
+    msg.msg_iovlen =
+        std::min<std::size_t>(conn.output.size() - conn.output_head, IOV_MAX);
+    ssize_t sent = ::sendmsg(conn.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent < 0) {
+      if (errno == EINTR) continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    while (sent > 0) {
+      iovec& head = conn.output[conn.output_head];
+      if (static_cast<std::size_t>(sent) < head.iov_len) {
+        head.iov_base = static_cast<char*>(head.iov_base) + sent;
+        head.iov_len -= static_cast<std::size_t>(sent);
+        break;
+      }
+      sent -= static_cast<ssize_t>(head.iov_len);
+      ++conn.output_head;
+    }
+  }
+  conn.output.clear();
+  conn.output_head = 0;
+  return true;
+}
+
+void queue(connection& conn, std::string_view response) {
+  conn.output.push_back(
+      {const_cast<char*>(response.data()), response.size()});
+}
+
+// Reads whatever is available and queues a response for every complete
+// request line. Returns false if the connection failed.
+bool read_requests(connection& conn, const response_table& responses) {
+  while (!conn.eof && conn.output.size() - conn.output_head <
+                          max_pending_responses) {
+    const ssize_t n = ::read(conn.fd, conn.input.data() + conn.input_size,
+                             conn.input.size() - conn.input_size);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (n == 0) {
+      conn.eof = true;
+    }
+
+    const char* data = conn.input.data();
+    const std::size_t size = conn.input_size + static_cast<std::size_t>(n);
+    std::size_t start = 0;
+    while (const void* nl = std::memchr(data + start, '\n', size - start)) {
+      const std::size_t end = static_cast<const char*>(nl) - data;
+      queue(conn, responses.find(std::string_view(data + start, end - start)));
+      start = end + 1;
+    }
+
+    if (conn.eof && start < size) {
+      queue(conn, responses.find(std::string_view(data + start, size - start)));
+      start = size;
+    } else if (start == 0 && size == conn.input.size()) {
+      queue(conn, responses.find({}));
+      conn.eof = true;
+      start = size;
+    }
+    conn.input_size = size - start;
+    std::memmove(conn.input.data(), data + start, conn.input_size);
+  }
+  return true;
+}
+
+tl::expected<int, std::error_code> listen_unix(const char* path) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (std::strlen(path) >= sizeof(addr.sun_path)) {
+    return tl::make_unexpected(
+        std::make_error_code(std::errc::filename_too_long));
+  }
+  std::strcpy(addr.sun_path, path);
+
+  struct stat st;
+  if (::lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+    ::unlink(path);
+  }
+
+  const int fd =
+      ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return tl::make_unexpected(last_error());
+  }
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    const std::error_code error = last_error();
+    ::close(fd);
+    return tl::make_unexpected(error);
+  }
+  return fd;
+}
+
+}  // namespace
+
+response_table::response_table() {
+  for (unsigned int code = min_code; code <= max_code; ++code) {
+    if (const auto desc = find_code(code)) {
+      const auto& [short_desc, long_desc, url] = *desc;
+      codes_[code - min_code] =
+          add("OK", format_output(code, short_desc, long_desc, url));
+    }
+  }
+  for (std::size_t i = 0; i < std::size(categories); ++i) {
+    categories_[i] =
+        add("OK", *list_all_codes_for_category(categories[i].name));
+  }
+  list_ = add("OK", list_all_codes());
+  invalid_code_ = add("ERR", invalid_code);
+  invalid_category_ = add("ERR", invalid_category);
+  invalid_request_ = add("ERR", "Error: Invalid request.\n");
+}
+
+response_table::span response_table::add(std::string_view status,
+                                         std::string_view body) {
+  span s;
+  s.offset = static_cast<std::uint32_t>(blob_.size());
+  blob_ += status;
+  blob_ += ' ';
+  blob_ += std::to_string(body.size());
+  blob_ += '\n';
+  blob_ += body;
+  s.size = static_cast<std::uint32_t>(blob_.size() - s.offset);
+  return s;
+}
+
+std::string_view response_table::find(std::string_view request) const noexcept {
+  if (!request.empty() && request.back() == '\r') {
+    request.remove_suffix(1);
+  }
+
+  if (request.size() == 3 &&
+      std::all_of(request.begin(), request.end(),
+                  [](char c) { return c >= '0' && c <= '9'; })) {
+    const unsigned int code = (request[0] - '0') * 100 +
+                              (request[1] - '0') * 10 + (request[2] - '0');
+    if (code >= min_code && code <= max_code &&
+        codes_[code - min_code].size != 0) {
+      return view(codes_[code - min_code]);
+    }
+    return view(invalid_code_);
+  }
+
+  if (request == "list") {
+    return view(list_);
+  }
+  if (request.starts_with("list ")) {
+    request.remove_prefix(5);
+    for (std::size_t i = 0; i < std::size(categories); ++i) {
+      if (categories[i].name == request) {
+        return view(categories_[i]);
+      }
+    }
+    return view(invalid_category_);
+  }
+  return view(invalid_request_);
+}
+
+tl::expected<void, std::error_code> serve(const char* socket_path) {
+  const response_table responses;
+
+  const auto listener = listen_unix(socket_path);
+  if (!listener.has_value()) {
+    return tl::make_unexpected(listener.error());
+  }
+  const int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    const std::error_code error = last_error();
+    ::close(*listener);
+    return tl::make_unexpected(error);
+  }
+  epoll_event listen_event{};
+  listen_event.events = EPOLLIN;
+  listen_event.data.fd = *listener;
+  ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, *listener, &listen_event);
+
+  struct sigaction action {};
+  action.sa_handler = request_stop;
+  ::sigaction(SIGINT, &action, nullptr);
+  ::sigaction(SIGTERM, &action, nullptr);
+
+  // Out of file descriptors, the listener stays readable and would wake the
+  // loop forever, so it is not watched until a connection closes.
+  bool accepting = true;
+  const auto watch_listener = [&](bool watch) {
+    listen_event.events = watch ? std::uint32_t{EPOLLIN} : 0;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, *listener, &listen_event);
+    accepting = watch;
+  };
+
+  // Connections indexed by file descriptor.
+  std::vector<std::unique_ptr<connection>> connections;
+  const auto close_connection = [&](connection& conn) {
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    ::close(conn.fd);
+    connections[conn.fd].reset();
+    if (!accepting) {
+      watch_listener(true);
+    }
+  };
+
+  std::array<epoll_event, 256> events;
+  std::error_code error;
+  while (!stop_requested) {
+    const int ready = ::epoll_wait(epoll_fd, events.data(), events.size(), -1);
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      error = last_error();
+      break;
+    }
+
+    for (int i = 0; i < ready; ++i) {
+      const int fd = events[i].data.fd;
+      if (fd == *listener) {
+        int client;
+        while ((client = ::accept4(*listener, nullptr, nullptr,
+                                   SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+          if (static_cast<std::size_t>(client) >= connections.size()) {
+            connections.resize(client + 1);
+          }
+          connections[client] = std::make_unique<connection>();
+          connections[client]->fd = client;
+          epoll_event event{};
+          event.events = EPOLLIN;
+          event.data.fd = client;
+          ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &event);
+        }
+        if (errno == EMFILE || errno == ENFILE) {
+          watch_listener(false);
+        }
+        continue;
+      }
+
+      connection& conn = *connections[fd];
+      if (!read_requests(conn, responses) || !flush(conn) ||
+          (events[i].events & EPOLLERR) != 0) {
+        close_connection(conn);
+        continue;
+      }
+
+      const bool pending = conn.output_head < conn.output.size();
+      if (!pending && conn.eof) {
+        close_connection(conn);
+        continue;
+      }
+      std::uint32_t wanted = pending ? std::uint32_t{EPOLLOUT} : 0;
+      if (!conn.eof && (!pending || conn.output.size() - conn.output_head <
+                                        max_pending_responses)) {
+        wanted |= EPOLLIN;
+      }
+      if (wanted != conn.events) {
+        epoll_event event{};
+        event.events = wanted;
+        event.data.fd = fd;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+        conn.events = wanted;
+      }
+    }
+  }
+
+  for (auto& conn : connections) {
+    if (conn != nullptr) {
+      ::close(conn->fd);
+    }
+  }
+  ::close(epoll_fd);
+  ::close(*listener);
+  ::unlink(socket_path);
+  if (error) {
+    return tl::make_unexpected(error);
+  }
+  return {};
+}
+
+}  // namespace httpcode
@@ -0,0 +1,67 @@
+#ifndef HTTPCODE_SERVER_HPP_
+#define HTTPCODE_SERVER_HPP_
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tl/expected.hpp>
+
+#include "httpcode/codes.hpp"
+
+namespace httpcode {
+
+/// Lookup daemon
+//
+// Clients send newline-delimited requests, which may be pipelined:
+//
+//   <code>
+//   list
+//   list <category-name>
+//
+// Every request is answered, in order, with a header line followed by a body
+// of exactly <length> bytes:
+//
+//   OK <length>\n<body>
+//   ERR <length>\n<message>
+//
+// The bodies are the same text that `httpcode <code>`, `httpcode list` and
+// `httpcode list <category-name>` print.
+
+// Every response the daemon can send, header included, rendered once into a
+// single buffer at startup.
+class response_table {
+ public:
+  response_table();
+
+  // Returns the response to a single request line (without its newline).
+  std::string_view find(std::string_view request) const noexcept;
+
+ private:
+  struct span {
+    std::uint32_t offset = 0;
+    std::uint32_t size = 0;
+  };
+
+  span add(std::string_view status, std::string_view body);
+  std::string_view view(span s) const noexcept {
+    return std::string_view(blob_).substr(s.offset, s.size);
+  }
+
+  std::string blob_;
+  std::array<span, max_code - min_code + 1> codes_;
+  std::array<span, std::size(categories)> categories_;
+  span list_;
+  span invalid_code_;
+  span invalid_category_;
+  span invalid_request_;
+};
+
+// Runs the daemon on a UNIX socket at `socket_path` until SIGINT or SIGTERM.
+// A stale socket file at that path is replaced.
+tl::expected<void, std::error_code> serve(const char* socket_path);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_SERVER_HPP_
@@ -0,0 +1,138 @@
+#include "snapshot.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#include "mapped_file.hpp"
+#include "stats.hpp"
+
+namespace httpcode {
+
+namespace {
+
+template <typename T>
+void append_bytes(output_buffer& out, const T& value) noexcept {
+  out.append(std::string_view(reinterpret_cast<const char*>(&value),
+                              sizeof(value)));
+}
+
+std::runtime_error snapshot_error(std::string_view reason) {
+  return std::runtime_error(std::string(reason));
+}
+
+std::runtime_error open_error(const char* path, std::string_view reason) {
+  std::string what = "Cannot read snapshot '";
+  what += path;
+  what += "': ";
+  what += reason;
+  return std::runtime_error(what);
+}
+
+}  // namespace
+
+void append_snapshot(output_buffer& out, const log_analysis& analysis,
+                     bool latencies) noexcept {
+  const latency_counts& l = analysis.latencies;
+  snapshot_counters counters{analysis.counts.codes, analysis.counts.malformed,
+                             {}};
+  std::uint32_t histograms = 0;
+  for (unsigned int code = 0; latencies && code < l.codes.size(); ++code) {
+    if (l.codes[code] != nullptr) {
+      counters.latency_codes[code / 64] |= std::uint64_t{1} << (code % 64);
+      ++histograms;
+    }
+  }
+
+  append_bytes(out, snapshot_header{snapshot_magic, snapshot_version,
+                                    snapshot_byte_order,
+                                    latencies ? snapshot_has_latencies : 0,
+                                    latency_histogram::bucket_count,
+                                    histograms, 0});
+  append_bytes(out, counters);
+  for (unsigned int code = 0; histograms != 0 && code < l.codes.size();
+       ++code) {
+    if (l.codes[code] != nullptr) {
+      append_bytes(out, l.codes[code]->count());
+      append_bytes(out, l.codes[code]->buckets());
+    }
+  }
+}
+
+tl::expected<bool, std::runtime_error> add_snapshot(std::string_view data,
+                                                    log_analysis& analysis) {
+  snapshot_header header;
+  if (data.size() < sizeof(header)) {
+    return tl::make_unexpected(snapshot_error("not a snapshot"));
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != snapshot_magic) {
+    return tl::make_unexpected(snapshot_error("not a snapshot"));
+  }
+  if (header.version != snapshot_version ||
+      header.byte_order != snapshot_byte_order ||
+      header.latency_buckets != latency_histogram::bucket_count) {
+    return tl::make_unexpected(
+        snapshot_error("unsupported snapshot version or byte order"));
+  }
+  if (data.size() != sizeof(header) + sizeof(snapshot_counters) +
+                         std::size_t{header.histograms} *
+                             sizeof(snapshot_histogram)) {
+    return tl::make_unexpected(snapshot_error("truncated snapshot"));
+  }
+
+  // The mapping is page-aligned and every part is a whole number of words,
+  // so the counters and histograms can be read where they are.
+  const auto& counters = *reinterpret_cast<const snapshot_counters*>(
+      data.data() + sizeof(header));
+  const auto* histograms = reinterpret_cast<const snapshot_histogram*>(
+      data.data() + sizeof(header) + sizeof(snapshot_counters));
+  std::size_t present = 0;
+  for (const std::uint64_t word : counters.latency_codes) {
+    present += std::popcount(word);
+  }
+  if (present != header.histograms ||
+      counters.latency_codes.back() >> (1000 % 64) != 0) {
+    return tl::make_unexpected(snapshot_error("corrupt histogram table"));
+  }
+
+  const stats::scoped_timer timer(stats::stage::merge);
+  status_counts& counts = analysis.counts;
+  for (std::size_t code = 0; code < counts.codes.size(); ++code) {
+    counts.codes[code] += counters.codes[code];
+  }
+  counts.malformed += counters.malformed;
+  for (std::size_t w = 0; w < counters.latency_codes.size(); ++w) {
+    for (std::uint64_t word = counters.latency_codes[w]; word != 0;
+         word &= word - 1) {
+      const auto code = w * 64 + std::countr_zero(word);
+      auto& histogram = analysis.latencies.codes[code];
+      if (histogram == nullptr) {
+        histogram = std::make_unique<latency_histogram>();
+      }
+      histogram->add(histograms->buckets, histograms->count);
+      ++histograms;
+    }
+  }
+  return (header.flags & snapshot_has_latencies) != 0;
+}
+
+tl::expected<bool, std::runtime_error> read_snapshots(
+    std::span<const char* const> paths, log_analysis& analysis) {
+  bool latencies = false;
+  for (const char* path : paths) {
+    const auto file = mapped_file::open(path);
+    if (!file.has_value()) {
+      return tl::make_unexpected(open_error(path, file.error().message()));
+    }
+    const auto added = add_snapshot(file->view(), analysis);
+    if (!added.has_value()) {
+      return tl::make_unexpected(open_error(path, added.error().what()));
+    }
+    latencies = latencies || *added;
+  }
+  return latencies;
+}
+
+}  // namespace httpcode
@@ -0,0 +1,84 @@
+#ifndef HTTPCODE_SNAPSHOT_HPP_
+#define HTTPCODE_SNAPSHOT_HPP_
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <tl/expected.hpp>
+
+#include "latency.hpp"
+#include "log_analysis.hpp"
+#include "output_buffer.hpp"
+
+namespace httpcode {
+
+/// Analysis snapshots
+//
+// The aggregated state of a log analysis, written by `histogram --snapshot`
+// so that results from many hosts can be combined by `merge` and printed by
+// `report` without the logs themselves:
+//
+//   snapshot_header
+//   snapshot_counters
+//   snapshot_histogram[histograms]   one per bit of `latency_codes`, by code
+//
+// Every part is a whole number of 64-bit words, so a mapped snapshot is read
+// in place and merged by adding words. Integers are stored in native byte
+// order, which `byte_order` records.
+
+inline constexpr std::array<char, 8> snapshot_magic = {'H', 'T', 'T', 'P',
+                                                       'C', 'S', 'N', 'P'};
+inline constexpr std::uint32_t snapshot_version = 1;
+inline constexpr std::uint32_t snapshot_byte_order = 0x01020304;
+
+// Set in `flags` if request times were analyzed, even if none were found.
+inline constexpr std::uint32_t snapshot_has_latencies = 1;
+
+struct snapshot_header {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint32_t flags;
+  // `latency_histogram::bucket_count` of the writer.
+  std::uint32_t latency_buckets;
+  std::uint32_t histograms;
+  std::uint32_t reserved;
+};
+
+struct snapshot_counters {
+  std::array<std::uint64_t, 1000> codes;
+  std::uint64_t malformed;
+  // Bitset of the codes that have a histogram, code `c` being bit `c % 64`
+  // of word `c / 64`.
+  std::array<std::uint64_t, 16> latency_codes;
+};
+
+struct snapshot_histogram {
+  std::uint64_t count;
+  std::array<std::uint64_t, latency_histogram::bucket_count> buckets;
+};
+
+static_assert(sizeof(snapshot_header) == 32);
+static_assert(sizeof(snapshot_counters) % 8 == 0);
+static_assert(sizeof(snapshot_histogram) % 8 == 0);
+
+// Appends `analysis` as a snapshot, including its request times if
+// `latencies` is set.
+void append_snapshot(output_buffer& out, const log_analysis& analysis,
+                     bool latencies) noexcept;
+
+// Adds the snapshot in `data` to `analysis` after checking its layout. Returns
+// whether it has request times.
+tl::expected<bool, std::runtime_error> add_snapshot(std::string_view data,
+                                                    log_analysis& analysis);
+
+// Maps the snapshots at `paths` one at a time and adds them to `analysis`.
+// Returns whether any of them has request times. Errors name the file.
+tl::expected<bool, std::runtime_error> read_snapshots(
+    std::span<const char* const> paths, log_analysis& analysis);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_SNAPSHOT_HPP_
@@ -0,0 +1,157 @@
+#include "stats.hpp"
+
+#include <mutex>
+
+#include "format.hpp"
+#include "output_buffer.hpp"
+
+namespace httpcode::stats {
+
+namespace {
+
+std::mutex totals_mutex;
+thread_stats totals;
+
+// Folds the counters of a thread into `totals` when it exits.
+struct registered_stats {
+  thread_stats s;
+
+  ~registered_stats() {
+    const std::lock_guard lock(totals_mutex);
+    totals += s;
+  }
+};
+
+std::uint64_t per_second(std::uint64_t n,
+                         std::chrono::nanoseconds elapsed) noexcept {
+  const auto nanos = static_cast<double>(std::max<std::int64_t>(
+      elapsed.count(), 1));
+  return static_cast<std::uint64_t>(static_cast<double>(n) * 1e9 / nanos);
+}
+
+void append_row(output_buffer& out, std::string_view label) noexcept {
+  out.append(label);
+  for (std::size_t i = label.size(); i < 16; ++i) out.append(' ');
+}
+
+}  // namespace
+
+thread_stats& thread_stats::operator+=(const thread_stats& other) noexcept {
+  for (std::size_t i = 0; i < counters.size(); ++i) {
+    counters[i] += other.counters[i];
+  }
+  for (std::size_t i = 0; i < stage_calls.size(); ++i) {
+    stage_calls[i] += other.stage_calls[i];
+    stage_nanos[i] += other.stage_nanos[i];
+  }
+  return *this;
+}
+
+#if HTTPCODE_STATS
+
+thread_stats& detail::local() noexcept {
+  thread_local registered_stats local;
+  return local.s;
+}
+
+void detail::add_stage(stage s,
+                       std::chrono::steady_clock::time_point start) noexcept {
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  thread_stats& t = local();
+  ++t.stage_calls[static_cast<unsigned int>(s)];
+  t.stage_nanos[static_cast<unsigned int>(s)] += static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+#endif  // HTTPCODE_STATS
+
+thread_stats collect() noexcept {
+  const std::lock_guard lock(totals_mutex);
+  thread_stats s = totals;
+#if HTTPCODE_STATS
+  if (detail::enabled) {
+    s += detail::local();
+  }
+#endif
+  return s;
+}
+
+void print(int fd, const thread_stats& s, std::chrono::nanoseconds elapsed,
+           bool json) noexcept {
+  const auto count = [&](counter c) {
+    return s.counters[static_cast<unsigned int>(c)];
+  };
+  const auto elapsed_micros = static_cast<std::uint64_t>(elapsed.count() / 1000);
+  output_buffer out(fd);
+
+  if (json) {
+    out.append("{\"elapsed_us\":");
+    out.append(elapsed_micros);
+    for (std::size_t i = 0; i < counter_names.size(); ++i) {
+      out.append(",\"");
+      out.append(counter_names[i]);
+      out.append("\":");
+      out.append(s.counters[i]);
+    }
+    out.append(",\"bytes_per_second\":");
+    out.append(per_second(count(counter::bytes_read), elapsed));
+    out.append(",\"lines_per_second\":");
+    out.append(per_second(count(counter::lines), elapsed));
+    out.append(",\"stages\":{");
+    bool first = true;
+    for (std::size_t i = 0; i < stage_names.size(); ++i) {
+      if (s.stage_calls[i] == 0) continue;
+      out.append(first ? "\"" : ",\"");
+      first = false;
+      out.append(stage_names[i]);
+      out.append("\":{\"calls\":");
+      out.append(s.stage_calls[i]);
+      out.append(",\"us\":");
+      out.append(s.stage_nanos[i] / 1000);
+      out.append('}');
+    }
+    out.append("}}\n");
+    out.flush();
+    return;
+  }
+
+  append_row(out, "elapsed");
+  append_duration(out, elapsed_micros);
+  out.append('\n');
+  append_row(out, "bytes read");
+  out.append(count(counter::bytes_read));
+  out.append(" (");
+  out.append(per_second(count(counter::bytes_read), elapsed));
+  out.append("/s)\n");
+  append_row(out, "bytes written");
+  out.append(count(counter::bytes_written));
+  out.append('\n');
+  append_row(out, "lines");
+  out.append(count(counter::lines));
+  out.append(" (");
+  out.append(per_second(count(counter::lines), elapsed));
+  out.append("/s)\n");
+  append_row(out, "parse failures");
+  out.append(count(counter::parse_failures));
+  out.append('\n');
+  append_row(out, "syscalls");
+  out.append(count(counter::read_calls));
+  out.append(" read, ");
+  out.append(count(counter::write_calls));
+  out.append(" write, ");
+  out.append(count(counter::map_calls));
+  out.append(" mmap\n");
+  append_row(out, "stage");
+  out.append("     calls  time\n");
+  for (std::size_t i = 0; i < stage_names.size(); ++i) {
+    if (s.stage_calls[i] == 0) continue;
+    append_row(out, stage_names[i]);
+    out.append(s.stage_calls[i], 10);
+    out.append("  ");
+    append_duration(out, s.stage_nanos[i] / 1000);
+    out.append('\n');
+  }
+  out.flush();
+}
+
+}  // namespace httpcode::stats
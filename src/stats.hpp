@@ -0,0 +1,136 @@
+#ifndef HTTPCODE_STATS_HPP_
+#define HTTPCODE_STATS_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Set by the build (the HTTPCODE_STATS option). With 0, every counter and
+// timer below compiles to nothing.
+#ifndef HTTPCODE_STATS
+#define HTTPCODE_STATS 1
+#endif
+
+namespace httpcode::stats {
+
+/// Instrumentation
+//
+// `--stats` reports what a run spent its time on. Code counts events with
+// `add` and times stages with `scoped_timer`. Both cost a single test of a
+// flag until `enable` is called. Every thread counts into its own
+// `thread_stats`, which is folded into a global total when the thread exits,
+// so counting takes no locks and no atomics.
+
+enum class counter : unsigned int {
+  bytes_read,
+  bytes_written,
+  lines,
+  parse_failures,
+  read_calls,
+  write_calls,
+  map_calls,
+};
+
+inline constexpr std::array<std::string_view, 7> counter_names = {
+    "bytes_read",  "bytes_written", "lines",    "parse_failures",
+    "read_calls",  "write_calls",   "map_calls"};
+
+enum class stage : unsigned int {
+  parse,
+  lookup,
+  render,
+  read,
+  write,
+  map,
+  scan,
+  decompress,
+  merge,
+};
+
+inline constexpr std::array<std::string_view, 9> stage_names = {
+    "parse", "lookup", "render",     "read", "write",
+    "map",   "scan",   "decompress", "merge"};
+
+struct thread_stats {
+  std::array<std::uint64_t, counter_names.size()> counters{};
+  std::array<std::uint64_t, stage_names.size()> stage_calls{};
+  std::array<std::uint64_t, stage_names.size()> stage_nanos{};
+
+  thread_stats& operator+=(const thread_stats& other) noexcept;
+};
+
+#if HTTPCODE_STATS
+
+namespace detail {
+
+inline bool enabled = false;
+
+// The counters of the calling thread.
+thread_stats& local() noexcept;
+
+// Out of line, so that the disabled path stays a single test and branch.
+void add_stage(stage s, std::chrono::steady_clock::time_point start) noexcept;
+
+}  // namespace detail
+
+// Starts counting. Must be called before any other thread is started.
+inline void enable() noexcept { detail::enabled = true; }
+
+inline void add(counter c, std::uint64_t n = 1) noexcept {
+  if (detail::enabled) [[unlikely]] {
+    detail::local().counters[static_cast<unsigned int>(c)] += n;
+  }
+}
+
+// Adds the time until the end of the scope to `s`.
+class scoped_timer {
+ public:
+  explicit scoped_timer(stage s) noexcept : stage_(s) {
+    if (detail::enabled) [[unlikely]] {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+  scoped_timer(const scoped_timer&) = delete;
+  scoped_timer& operator=(const scoped_timer&) = delete;
+  ~scoped_timer() {
+    if (detail::enabled) [[unlikely]] {
+      detail::add_stage(stage_, start_);
+    }
+  }
+
+ private:
+  stage stage_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+#else
+
+inline void enable() noexcept {}
+
+inline void add(counter, std::uint64_t = 1) noexcept {}
+
+class scoped_timer {
+ public:
+  explicit scoped_timer(stage) noexcept {}
+  scoped_timer(const scoped_timer&) = delete;
+  scoped_timer& operator=(const scoped_timer&) = delete;
+};
+
+#endif  // HTTPCODE_STATS
+
+inline constexpr bool compiled_in = HTTPCODE_STATS != 0;
+
+// Returns the counters of every thread that has exited plus those of the
+// calling thread.
+thread_stats collect() noexcept;
+
+// Writes `s` for a run that took `elapsed` to `fd`, as a table or as a JSON
+// object.
+void print(int fd, const thread_stats& s, std::chrono::nanoseconds elapsed,
+           bool json) noexcept;
+
+}  // namespace httpcode::stats
+
+#endif  // HTTPCODE_STATS_HPP_
@@ -0,0 +1,240 @@
+#include "top_keys.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <utility>
+
+#include "log_scan.hpp"
+
+namespace httpcode {
+
+namespace {
+
+// FNV-1a over the code and the key.
+std::uint64_t hash_pair(unsigned int code, std::string_view key) noexcept {
+  std::uint64_t h = 0xcbf29ce484222325 ^ code;
+  for (const char c : key) {
+    h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+  }
+  return h;
+}
+
+}  // namespace
+
+std::optional<top_key> find_top_key(std::string_view name) noexcept {
+  if (name == "path") return top_key::path;
+  if (name == "client") return top_key::client;
+  if (name == "upstream") return top_key::upstream;
+  return std::nullopt;
+}
+
+std::optional<std::string_view> extract_top_key(std::string_view line,
+                                                top_key key,
+                                                int field) noexcept {
+  switch (key) {
+    case top_key::path: {
+      // "GET /path?query HTTP/1.1"
+      const std::size_t request = line.find('"');
+      const std::size_t begin = line.find(' ', request + 1);
+      if (request == std::string_view::npos ||
+          begin == std::string_view::npos) {
+        return std::nullopt;
+      }
+      const std::size_t end = line.find_first_of(" ?\"", begin + 1);
+      if (end == std::string_view::npos || end == begin + 1) {
+        return std::nullopt;
+      }
+      return line.substr(begin + 1, end - begin - 1);
+    }
+    case top_key::client:
+      return find_field(line, 1);
+    case top_key::upstream:
+      return find_field(line, field);
+  }
+  return std::nullopt;
+}
+
+space_saving::space_saving(std::size_t capacity)
+    : capacity_(capacity),
+      keys_(std::make_unique_for_overwrite<char[]>(capacity * max_key_size)),
+      heap_pos_(capacity),
+      table_(std::bit_ceil(capacity * 2), empty) {
+  slots_.reserve(capacity);
+  heap_.reserve(capacity);
+}
+
+std::size_t space_saving::find(std::uint64_t hash, unsigned int code,
+                               std::string_view key) const noexcept {
+  const std::size_t mask = table_.size() - 1;
+  for (std::size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+    const std::uint32_t s = table_[pos];
+    if (s == empty || (slots_[s].hash == hash && slots_[s].code == code &&
+                       this->key(s) == key)) {
+      return pos;
+    }
+  }
+}
+
+// Backward-shift deletion, which keeps every probe sequence unbroken without
+// tombstones.
+void space_saving::erase(std::size_t pos) noexcept {
+  const std::size_t mask = table_.size() - 1;
+  for (std::size_t next = (pos + 1) & mask; table_[next] != empty;
+       next = (next + 1) & mask) {
+    const std::size_t home = slots_[table_[next]].hash & mask;
+    // Move the entry back unless its home lies cyclically in (pos, next].
+    const bool stays = pos <= next ? pos < home && home <= next
+                                   : pos < home || home <= next;
+    if (!stays) {
+      table_[pos] = table_[next];
+      pos = next;
+    }
+  }
+  table_[pos] = empty;
+}
+
+void space_saving::assign(std::uint32_t s, std::uint64_t hash,
+                          unsigned int code, std::string_view key) noexcept {
+  slots_[s].hash = hash;
+  slots_[s].code = code;
+  slots_[s].key_size = static_cast<std::uint32_t>(key.size());
+  std::memcpy(keys_.get() + std::size_t{s} * max_key_size, key.data(),
+              key.size());
+}
+
+void space_saving::swap_heap(std::size_t i, std::size_t j) noexcept {
+  std::swap(heap_[i], heap_[j]);
+  heap_pos_[heap_[i]] = static_cast<std::uint32_t>(i);
+  heap_pos_[heap_[j]] = static_cast<std::uint32_t>(j);
+}
+
+void space_saving::sift_up(std::size_t i) noexcept {
+  while (i > 0) {
+    const std::size_t parent = (i - 1) / 2;
+    if (slots_[heap_[parent]].count <= slots_[heap_[i]].count) {
+      return;
+    }
+    swap_heap(i, parent);
+    i = parent;
+  }
+}
+
+void space_saving::sift_down(std::size_t i) noexcept {
+  for (;;) {
+    std::size_t least = i;
+    for (const std::size_t child : {2 * i + 1, 2 * i + 2}) {
+      if (child < heap_.size() &&
+          slots_[heap_[child]].count < slots_[heap_[least]].count) {
+        least = child;
+      }
+    }
+    if (least == i) {
+      return;
+    }
+    swap_heap(i, least);
+    i = least;
+  }
+}
+
+void space_saving::add(unsigned int code, std::string_view key,
+                       std::uint64_t count, std::uint64_t error) {
+  key = key.substr(0, max_key_size);
+  const std::uint64_t hash = hash_pair(code, key);
+  const std::size_t pos = find(hash, code, key);
+  if (table_[pos] != empty) {
+    const std::uint32_t s = table_[pos];
+    slots_[s].count += count;
+    slots_[s].error += error;
+    sift_down(heap_pos_[s]);
+    return;
+  }
+
+  if (slots_.size() < capacity_) {
+    const auto s = static_cast<std::uint32_t>(slots_.size());
+    slots_.push_back({count, error, 0, 0, 0});
+    assign(s, hash, code, key);
+    table_[pos] = s;
+    heap_pos_[s] = static_cast<std::uint32_t>(heap_.size());
+    heap_.push_back(s);
+    sift_up(heap_.size() - 1);
+    return;
+  }
+
+  // Take over the slot with the lowest count. Its count may all belong to
+  // the evicted pair, which makes it the error of the new one.
+  const std::uint32_t s = heap_[0];
+  erase(find(slots_[s].hash, slots_[s].code, this->key(s)));
+  const std::uint64_t evicted = slots_[s].count;
+  slots_[s].count = evicted + count;
+  slots_[s].error = evicted + error;
+  assign(s, hash, code, key);
+  table_[find(hash, code, key)] = s;
+  sift_down(0);
+}
+
+space_saving& space_saving::operator+=(const space_saving& other) {
+  for (std::uint32_t s = 0; s < other.slots_.size(); ++s) {
+    add(other.slots_[s].code, other.key(s), other.slots_[s].count,
+        other.slots_[s].error);
+  }
+  return *this;
+}
+
+std::vector<space_saving::entry> space_saving::top(unsigned int code,
+                                                   std::size_t k) const {
+  std::vector<entry> entries;
+  for (std::uint32_t s = 0; s < slots_.size(); ++s) {
+    if (slots_[s].code == code) {
+      entries.push_back({code, key(s), slots_[s].count, slots_[s].error});
+    }
+  }
+  const auto by_count = [](const entry& a, const entry& b) {
+    return a.count != b.count ? a.count > b.count : a.key < b.key;
+  };
+  const std::size_t n = std::min(k, entries.size());
+  std::partial_sort(entries.begin(), entries.begin() + n, entries.end(),
+                    by_count);
+  entries.resize(n);
+  return entries;
+}
+
+top_keys::top_keys(top_key key, std::size_t k, int field) noexcept
+    : key_(key), k_(k), field_(field) {}
+
+void top_keys::record(unsigned int code, std::string_view line) {
+  if (code < 100 || code >= 600) {
+    return;
+  }
+  const auto key = extract_top_key(line, key_, field_);
+  if (!key.has_value()) {
+    return;
+  }
+  auto& sketch = classes_[code / 100 - 1];
+  if (sketch == nullptr) {
+    sketch = std::make_unique<space_saving>(sketch_capacity);
+  }
+  sketch->add(code, *key);
+}
+
+top_keys& top_keys::operator+=(const top_keys& other) {
+  for (std::size_t c = 0; c < classes_.size(); ++c) {
+    if (other.classes_[c] == nullptr) {
+      continue;
+    }
+    if (classes_[c] == nullptr) {
+      classes_[c] = std::make_unique<space_saving>(sketch_capacity);
+    }
+    *classes_[c] += *other.classes_[c];
+  }
+  return *this;
+}
+
+std::vector<space_saving::entry> top_keys::top(unsigned int code) const {
+  if (code < 100 || code >= 600 || classes_[code / 100 - 1] == nullptr) {
+    return {};
+  }
+  return classes_[code / 100 - 1]->top(code, k_);
+}
+
+}  // namespace httpcode
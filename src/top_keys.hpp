@@ -0,0 +1,136 @@
+#ifndef HTTPCODE_TOP_KEYS_HPP_
+#define HTTPCODE_TOP_KEYS_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace httpcode {
+
+/// Top keys
+//
+// `histogram --top-by <key> K` attributes every status code to the request
+// paths, clients or upstreams that produce it most. Counting every distinct
+// key exactly would take memory in proportion to the number of keys, so each
+// status class is tracked by a Space-Saving sketch of fixed capacity
+// instead. A sketch counts (code, key) pairs. When a pair that is not yet
+// tracked arrives and the sketch is full, it takes over the slot with the
+// lowest count and inherits that count as its error. Every reported count is
+// then at most `error` above the true one, and any pair whose true count
+// exceeds total / capacity is reported.
+//
+// The capacity is fixed, whatever K and the number of workers, so memory is
+// bounded by one sketch per class and worker. With `n` lines in a class, no
+// error exceeds n / `sketch_capacity`; a large K only lists more of the pairs
+// that survive, whose counts are less certain the further down they are.
+
+enum class top_key { path, client, upstream };
+
+// Slots per sketch, about 700 KiB.
+inline constexpr std::size_t sketch_capacity = 4096;
+
+// Returns the key with the given name, or nothing if there is none.
+std::optional<top_key> find_top_key(std::string_view name) noexcept;
+
+// Returns the `key` of an access log line, where `field` is the field holding
+// the upstream address. Paths are taken from the request line without their
+// query string.
+std::optional<std::string_view> extract_top_key(std::string_view line,
+                                                top_key key,
+                                                int field) noexcept;
+
+// Space-Saving sketch of (code, key) pairs. All memory is allocated up front:
+// keys live in fixed-size slots of a single arena, which are reused when a
+// pair is evicted, and a min-heap finds the pair to evict.
+class space_saving {
+ public:
+  // Longer keys are cut short, so that a slot always fits.
+  static constexpr std::size_t max_key_size = 120;
+
+  struct entry {
+    unsigned int code;
+    std::string_view key;
+    std::uint64_t count;
+    // The true count lies in [count - error, count].
+    std::uint64_t error;
+  };
+
+  explicit space_saving(std::size_t capacity);
+
+  // Counts `count` occurrences of `key` under `code`, of which up to `error`
+  // may not have happened (when adding another sketch).
+  void add(unsigned int code, std::string_view key, std::uint64_t count = 1,
+           std::uint64_t error = 0);
+
+  // Adds every pair of `other` with its count and error, which keeps the
+  // guarantees of both sketches.
+  space_saving& operator+=(const space_saving& other);
+
+  // Returns up to `k` pairs of `code` with the highest counts, highest first.
+  std::vector<entry> top(unsigned int code, std::size_t k) const;
+
+ private:
+  struct slot {
+    std::uint64_t count;
+    std::uint64_t error;
+    std::uint64_t hash;
+    std::uint32_t code;
+    std::uint32_t key_size;
+  };
+
+  static constexpr std::uint32_t empty = 0xffffffff;
+
+  std::string_view key(std::uint32_t s) const noexcept {
+    return {keys_.get() + std::size_t{s} * max_key_size, slots_[s].key_size};
+  }
+
+  // Returns the position in `table_` of the pair, or of the empty entry where
+  // it would go.
+  std::size_t find(std::uint64_t hash, unsigned int code,
+                   std::string_view key) const noexcept;
+  void erase(std::size_t pos) noexcept;
+  void assign(std::uint32_t s, std::uint64_t hash, unsigned int code,
+              std::string_view key) noexcept;
+  void sift_up(std::size_t i) noexcept;
+  void sift_down(std::size_t i) noexcept;
+  void swap_heap(std::size_t i, std::size_t j) noexcept;
+
+  std::size_t capacity_;
+  std::vector<slot> slots_;
+  std::unique_ptr<char[]> keys_;
+  // Min-heap of slots by count, and the heap position of each slot.
+  std::vector<std::uint32_t> heap_;
+  std::vector<std::uint32_t> heap_pos_;
+  // Open-addressed hash table of slots, probed linearly.
+  std::vector<std::uint32_t> table_;
+};
+
+// One sketch per status class, created on first use.
+class top_keys {
+ public:
+  top_keys(top_key key, std::size_t k, int field) noexcept;
+
+  // Returns an instance with the same settings and no sketches.
+  top_keys empty_copy() const noexcept { return {key_, k_, field_}; }
+
+  void record(unsigned int code, std::string_view line);
+
+  top_keys& operator+=(const top_keys& other);
+
+  // Returns the top keys of `code` as `space_saving::top` does.
+  std::vector<space_saving::entry> top(unsigned int code) const;
+
+ private:
+  top_key key_;
+  std::size_t k_;
+  int field_;
+  std::array<std::unique_ptr<space_saving>, 5> classes_;
+};
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_TOP_KEYS_HPP_
@@ -0,0 +1,346 @@
+#include "watch.hpp"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "stats.hpp"
+
+namespace httpcode {
+
+void status_window::advance() noexcept {
+  head_ = (head_ + 1) % capacity;
+  auto& codes = codes_[head_];
+  auto& totals = categories_[head_];
+
+  std::uint64_t rest = current_.malformed;
+  for (std::size_t code = 0; code < codes.size(); ++code) {
+    codes[code] = static_cast<std::uint32_t>(current_.codes[code]);
+    rest += current_.codes[code];
+  }
+  for (std::size_t i = 0; i < std::size(categories); ++i) {
+    std::uint64_t total = 0;
+    for (unsigned int code = categories[i].first_code;
+         code <= categories[i].last_code; ++code) {
+      total += current_.codes[code];
+    }
+    totals[i] = total;
+    rest -= total;
+  }
+  totals[other] = rest;
+
+  current_ = {};
+  seconds_ = std::min(seconds_ + 1, capacity);
+}
+
+std::uint64_t status_window::code_count(unsigned int code,
+                                        std::size_t n) const noexcept {
+  std::uint64_t count = 0;
+  for (std::size_t i = 0; i < std::min(n, seconds_); ++i) {
+    count += codes_[(head_ + capacity - i) % capacity][code];
+  }
+  return count;
+}
+
+std::uint64_t status_window::category_count(std::size_t category,
+                                            std::size_t n) const noexcept {
+  std::uint64_t count = 0;
+  for (std::size_t i = 0; i < std::min(n, seconds_); ++i) {
+    count += categories_[(head_ + capacity - i) % capacity][category];
+  }
+  return count;
+}
+
+namespace {
+
+constexpr std::size_t rate_windows[] = {1, 10, 60};
+constexpr std::size_t top_window = 10;
+constexpr std::size_t name_width = 14;
+constexpr std::size_t rate_width = 10;
+
+// Appends `name` followed by the rates of `category` and, if known, its most
+// frequent code.
+void append_rate_row(output_buffer& out, const status_window& window,
+                     std::string_view name, std::size_t category,
+                     unsigned int top_code) noexcept {
+  out.append(name);
+  for (std::size_t n = name.size(); n < name_width; ++n) {
+    out.append(' ');
+  }
+  for (const std::size_t seconds : rate_windows) {
+    // Until a window has filled up, average over the seconds seen so far.
+    const std::uint64_t divisor =
+        std::max<std::size_t>(std::min(seconds, window.seconds()), 1);
+    const std::uint64_t count = window.category_count(category, seconds);
+    out.append((count + divisor / 2) / divisor, rate_width);
+  }
+  if (top_code != 0) {
+    out.append("  ");
+    out.append(top_code);
+  }
+  out.append('\n');
+}
+
+}  // namespace
+
+void append_rates(output_buffer& out, const status_window& window) noexcept {
+  out.append("lines/s              1s       10s       60s  top\n");
+  for (std::size_t i = 0; i < std::size(categories); ++i) {
+    const category& c = categories[i];
+    unsigned int top_code = 0;
+    std::uint64_t top_count = 0;
+    for (unsigned int code = c.first_code; code <= c.last_code; ++code) {
+      const std::uint64_t count = window.code_count(code, top_window);
+      if (count > top_count) {
+        top_code = code;
+        top_count = count;
+      }
+    }
+    append_rate_row(out, window, c.name, i, top_code);
+  }
+  append_rate_row(out, window, "other", status_window::other, 0);
+  out.append('\n');
+}
+
+namespace {
+
+std::error_code last_error() noexcept {
+  return std::error_code(errno, std::generic_category());
+}
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+extern "C" void request_watch_stop(int) { stop_requested = 1; }
+
+constexpr std::size_t read_buffer_size = 1 << 20;
+
+// Upper bound on what a single `drain` reads, so that a writer that appends
+// faster than it can be scanned cannot hold off the once-per-second output.
+constexpr std::size_t max_drain_size = 64 << 20;
+
+// How many seconds a rotated file is still read after it has been replaced,
+// for writers that have yet to reopen the log.
+constexpr int rotation_grace = 5;
+
+// An open log file, and the unterminated line at the end of what has been read
+// from it so far.
+struct follower {
+  int fd = -1;
+  off_t offset = 0;
+  std::size_t pending = 0;
+  std::unique_ptr<char[]> buffer = std::make_unique<char[]>(read_buffer_size);
+
+  follower() = default;
+  follower(const follower&) = delete;
+  follower& operator=(const follower&) = delete;
+  follower(follower&& other) noexcept
+      : fd(std::exchange(other.fd, -1)),
+        offset(other.offset),
+        pending(other.pending),
+        buffer(std::move(other.buffer)) {}
+  follower& operator=(follower&& other) noexcept {
+    std::swap(fd, other.fd);
+    std::swap(offset, other.offset);
+    std::swap(pending, other.pending);
+    std::swap(buffer, other.buffer);
+    return *this;
+  }
+  ~follower() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+};
+
+// Reads what has been appended to `f` and counts every complete line. A file
+// that has shrunk below what has been read was truncated and is read again
+// from its start.
+void drain(follower& f, status_counts& counts) noexcept {
+  char* const data = f.buffer.get();
+  std::size_t total = 0;
+  while (f.fd >= 0 && total < max_drain_size) {
+    const ssize_t n =
+        ::read(f.fd, data + f.pending, read_buffer_size - f.pending);
+    stats::add(stats::counter::read_calls);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    stats::add(stats::counter::bytes_read, static_cast<std::size_t>(n));
+    if (n == 0) {
+      struct stat st;
+      if (::fstat(f.fd, &st) == 0 && st.st_size < f.offset &&
+          ::lseek(f.fd, 0, SEEK_SET) == 0) {
+        f.offset = 0;
+        f.pending = 0;
+        continue;
+      }
+      return;
+    }
+    f.offset += n;
+    total += static_cast<std::size_t>(n);
+
+    const std::size_t size = f.pending + static_cast<std::size_t>(n);
+    const void* nl = ::memrchr(data, '\n', size);
+    if (nl != nullptr) {
+      const std::size_t end = static_cast<const char*>(nl) - data + 1;
+      scan_log(std::string_view(data, end), counts);
+      f.pending = size - end;
+      std::memmove(data, data + end, f.pending);
+    } else if (size == read_buffer_size) {
+      // A line longer than the buffer is counted in pieces.
+      scan_log(std::string_view(data, size), counts);
+      f.pending = 0;
+    } else {
+      f.pending = size;
+    }
+  }
+}
+
+}  // namespace
+
+tl::expected<void, std::error_code> watch_log(const char* path, int out_fd) {
+  const std::string_view full_path = path;
+  const std::size_t slash = full_path.rfind('/');
+  const std::string dir =
+      slash == std::string_view::npos
+          ? std::string(".")
+          : std::string(full_path.substr(0, std::max<std::size_t>(slash, 1)));
+  const std::string_view name = slash == std::string_view::npos
+                                    ? full_path
+                                    : full_path.substr(slash + 1);
+
+  follower current;
+  current.fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (current.fd < 0 ||
+      (current.offset = ::lseek(current.fd, 0, SEEK_END)) < 0) {
+    return tl::make_unexpected(last_error());
+  }
+
+  // The directory is watched rather than the file, so that a new file created
+  // under the same name is noticed as well as appends to the current one.
+  const int inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  const int timer_fd =
+      ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  const int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+  const auto close_all = [&] {
+    for (const int fd : {inotify_fd, timer_fd, epoll_fd}) {
+      if (fd >= 0) ::close(fd);
+    }
+  };
+  const itimerspec interval{{1, 0}, {1, 0}};
+  if (inotify_fd < 0 || timer_fd < 0 || epoll_fd < 0 ||
+      ::inotify_add_watch(inotify_fd, dir.c_str(),
+                          IN_MODIFY | IN_CREATE | IN_MOVED_TO) < 0 ||
+      ::timerfd_settime(timer_fd, 0, &interval, nullptr) != 0) {
+    const std::error_code error = last_error();
+    close_all();
+    return tl::make_unexpected(error);
+  }
+  for (const int fd : {inotify_fd, timer_fd}) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+  }
+
+  struct sigaction action {};
+  action.sa_handler = request_watch_stop;
+  ::sigaction(SIGINT, &action, nullptr);
+  ::sigaction(SIGTERM, &action, nullptr);
+
+  const auto window = std::make_unique<status_window>();
+  output_buffer out(out_fd);
+  follower previous;
+  int previous_ticks = 0;
+
+  std::array<epoll_event, 2> events;
+  alignas(inotify_event) char notifications[4096];
+  std::error_code error;
+  while (!stop_requested) {
+    const int ready = ::epoll_wait(epoll_fd, events.data(), events.size(), -1);
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      error = last_error();
+      break;
+    }
+
+    bool replaced = false;
+    std::uint64_t ticks = 0;
+    for (int i = 0; i < ready; ++i) {
+      if (events[i].data.fd == timer_fd) {
+        std::uint64_t expirations;
+        if (::read(timer_fd, &expirations, sizeof(expirations)) ==
+            sizeof(expirations)) {
+          ticks += expirations;
+        }
+        continue;
+      }
+      ssize_t n;
+      while ((n = ::read(inotify_fd, notifications, sizeof(notifications))) >
+             0) {
+        for (ssize_t offset = 0; offset < n;) {
+          const auto* event =
+              reinterpret_cast<const inotify_event*>(notifications + offset);
+          if (event->len != 0 && event->name == name &&
+              (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+            replaced = true;
+          }
+          offset += sizeof(inotify_event) + event->len;
+        }
+      }
+    }
+
+    drain(current, window->current());
+    if (replaced) {
+      const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+      if (fd >= 0) {
+        previous = std::move(current);
+        previous_ticks = rotation_grace;
+        current = follower();
+        current.fd = fd;
+        drain(current, window->current());
+      }
+    }
+
+    if (ticks != 0) {
+      if (previous.fd >= 0) {
+        drain(previous, window->current());
+        if (--previous_ticks <= 0) {
+          previous = follower();
+        }
+      }
+      for (std::uint64_t i = 0; i < std::min<std::uint64_t>(
+                                        ticks, status_window::capacity);
+           ++i) {
+        window->advance();
+      }
+      append_rates(out, *window);
+      if (!out.flush()) {
+        break;
+      }
+    }
+  }
+
+  close_all();
+  if (error) {
+    return tl::make_unexpected(error);
+  }
+  return {};
+}
+
+}  // namespace httpcode
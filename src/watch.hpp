@@ -0,0 +1,65 @@
+#ifndef HTTPCODE_WATCH_HPP_
+#define HTTPCODE_WATCH_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+#include <tl/expected.hpp>
+
+#include "httpcode/codes.hpp"
+#include "log_scan.hpp"
+#include "output_buffer.hpp"
+
+namespace httpcode {
+
+/// Follow mode
+
+// Per-second status code counters for the last `capacity` seconds, in fixed
+// memory. Lines are counted into `current()` as they arrive, and `advance()`
+// closes the current second, folding it into a ring of past seconds together
+// with its per-category totals.
+class status_window {
+ public:
+  static constexpr std::size_t capacity = 60;
+
+  // Index of the counter for lines that fall in no category, i.e. codes
+  // outside [100, 599] and lines without a status field.
+  static constexpr std::size_t other = std::size(categories);
+
+  status_counts& current() noexcept { return current_; }
+
+  void advance() noexcept;
+
+  // Number of seconds closed so far, up to `capacity`.
+  std::size_t seconds() const noexcept { return seconds_; }
+
+  // Number of lines in the last `n` closed seconds.
+  std::uint64_t code_count(unsigned int code, std::size_t n) const noexcept;
+  std::uint64_t category_count(std::size_t category,
+                               std::size_t n) const noexcept;
+
+ private:
+  status_counts current_;
+  // Slot `head_` holds the most recent closed second.
+  std::array<std::array<std::uint32_t, 1000>, capacity> codes_{};
+  std::array<std::array<std::uint64_t, other + 1>, capacity> categories_{};
+  std::size_t head_ = capacity - 1;
+  std::size_t seconds_ = 0;
+};
+
+// Appends the 1s, 10s and 60s line rates of every category in `window`, and the
+// most frequent code of each category over the last 10 seconds.
+void append_rates(output_buffer& out, const status_window& window) noexcept;
+
+// Follows the access log at `path` like `tail -F`, starting at its current end,
+// and writes the rates of the last second to `out_fd` once per second until
+// SIGINT or SIGTERM. Appends are picked up through inotify and read
+// incrementally. When the file is replaced (rotated), the new file is read
+// from its start and the old one is still drained for a few seconds; when it
+// is truncated, reading restarts at its start.
+tl::expected<void, std::error_code> watch_log(const char* path, int out_fd);
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_WATCH_HPP_
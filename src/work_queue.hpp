@@ -0,0 +1,106 @@
+#ifndef HTTPCODE_WORK_QUEUE_HPP_
+#define HTTPCODE_WORK_QUEUE_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace httpcode {
+
+// A contiguous range of work item indices owned by one worker. The owner takes
+// items from the front while other workers steal from the back. Both ends are
+// packed into a single word so that either operation is one compare-exchange.
+class alignas(64) work_range {
+ public:
+  void assign(std::uint32_t begin, std::uint32_t end) noexcept {
+    bounds_.store(pack(begin, end), std::memory_order_relaxed);
+  }
+
+  std::optional<std::uint32_t> pop_front() noexcept {
+    std::uint64_t bounds = bounds_.load(std::memory_order_relaxed);
+    for (;;) {
+      const std::uint32_t head = bounds >> 32;
+      const std::uint32_t tail = static_cast<std::uint32_t>(bounds);
+      if (head >= tail) {
+        return std::nullopt;
+      }
+      if (bounds_.compare_exchange_weak(bounds, pack(head + 1, tail),
+                                        std::memory_order_relaxed)) {
+        return head;
+      }
+    }
+  }
+
+  std::optional<std::uint32_t> steal_back() noexcept {
+    std::uint64_t bounds = bounds_.load(std::memory_order_relaxed);
+    for (;;) {
+      const std::uint32_t head = bounds >> 32;
+      const std::uint32_t tail = static_cast<std::uint32_t>(bounds);
+      if (head >= tail) {
+        return std::nullopt;
+      }
+      if (bounds_.compare_exchange_weak(bounds, pack(head, tail - 1),
+                                        std::memory_order_relaxed)) {
+        return tail - 1;
+      }
+    }
+  }
+
+ private:
+  static constexpr std::uint64_t pack(std::uint32_t head,
+                                      std::uint32_t tail) noexcept {
+    return std::uint64_t{head} << 32 | tail;
+  }
+
+  std::atomic<std::uint64_t> bounds_{0};
+};
+
+// Runs `fn(worker, item)` for every item in [0, items) on `threads` threads.
+// Each worker starts with an equal contiguous share of the items and steals
+// from the others once its own share is exhausted. The calling thread acts as
+// worker 0. The item set is fixed, so a worker stops as soon as every range it
+// looks at is empty.
+template <typename Fn>
+void run_work_stealing(std::uint32_t items, unsigned int threads, Fn&& fn) {
+  if (threads <= 1 || items <= 1) {
+    for (std::uint32_t item = 0; item < items; ++item) {
+      fn(0u, item);
+    }
+    return;
+  }
+
+  const auto ranges = std::make_unique<work_range[]>(threads);
+  for (unsigned int w = 0; w < threads; ++w) {
+    ranges[w].assign(static_cast<std::uint64_t>(items) * w / threads,
+                     static_cast<std::uint64_t>(items) * (w + 1) / threads);
+  }
+
+  const auto work = [&](unsigned int worker) {
+    while (const auto item = ranges[worker].pop_front()) {
+      fn(worker, *item);
+    }
+    for (unsigned int i = 1; i < threads; ++i) {
+      work_range& victim = ranges[(worker + i) % threads];
+      while (const auto item = victim.steal_back()) {
+        fn(worker, *item);
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (unsigned int w = 1; w < threads; ++w) {
+    pool.emplace_back(work, w);
+  }
+  work(0);
+  for (std::thread& t : pool) {
+    t.join();
+  }
+}
+
+}  // namespace httpcode
+
+#endif  // HTTPCODE_WORK_QUEUE_HPP_
@@ -0,0 +1,433 @@
+// Checks `analyze_logs` on generated logs, whose exact counts are known.
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "code_set.hpp"
+#include "format.hpp"
+#include "latency.hpp"
+#include "log_analysis.hpp"
+#include "log_sample.hpp"
+#include "log_scan.hpp"
+#include "registry.hpp"
+#include "snapshot.hpp"
+#include "test_log.hpp"
+
+namespace {
+
+using httpcode::status_counts;
+using httpcode::test::check;
+
+// Returns whether `result` failed with an error that mentions `reason`.
+template <typename T>
+bool fails_with(const tl::expected<T, std::runtime_error>& result,
+                std::string_view reason) {
+  return !result.has_value() &&
+         std::string_view(result.error().what()).find(reason) !=
+             std::string_view::npos;
+}
+
+bool same_counts(const status_counts& a, const status_counts& b) {
+  return a.codes == b.codes && a.malformed == b.malformed;
+}
+
+// A log along with what it holds, as it was written.
+struct generated_log {
+  std::string text;
+  status_counts counts;
+  // Request times in microseconds, by code.
+  std::array<std::vector<std::uint64_t>, 1000> latencies;
+  // Lines by code and request path.
+  std::map<std::pair<unsigned int, std::string>, std::uint64_t> paths;
+};
+
+// Writes `lines` lines of varying length with request times in the last
+// field, a few of them without a time or without a status field. Paths are
+// skewed, so that top keys have distinct counts, but few enough that the
+// sketches hold every one of them exactly.
+generated_log generate_log(std::size_t lines, std::uint64_t seed) {
+  static constexpr unsigned int codes[] = {200, 200, 200, 200, 201,
+                                           301, 304, 404, 404, 429,
+                                           500, 502, 503, 599, 999};
+  std::mt19937_64 random(seed);
+  generated_log log;
+  for (std::size_t i = 0; i < lines; ++i) {
+    if (random() % 500 == 0) {
+      log.text += "truncated line " + std::to_string(i) + "\n";
+      ++log.counts.malformed;
+      continue;
+    }
+    const unsigned int code = codes[random() % std::size(codes)];
+    const std::string path =
+        "/p" + std::to_string(random() % (random() % 300 + 1));
+    const std::uint64_t micros = random() % 2'000'000;
+    const bool timed = random() % 50 != 0;
+    char time[32] = "-";
+    if (timed) {
+      std::snprintf(time, sizeof(time), "%llu.%06llu",
+                    static_cast<unsigned long long>(micros / 1'000'000),
+                    static_cast<unsigned long long>(micros % 1'000'000));
+      log.latencies[code].push_back(micros);
+    }
+    char code_field[4];
+    std::snprintf(code_field, sizeof(code_field), "%03u", code);
+    log.text += "10.0." + std::to_string(random() % 256) + "." +
+                std::to_string(random() % 256) +
+                " - - [10/Oct/2000:13:55:36 -0700] \"GET " + path + "?q=" +
+                std::string(random() % 40, 'a') + " HTTP/1.1\" " + code_field +
+                " " + std::to_string(random() % 100000) +
+                " \"-\" \"agent\" " + time + "\n";
+    ++log.counts.codes[code];
+    ++log.paths[{code, path}];
+  }
+  return log;
+}
+
+// Counts the lines of `data` one at a time with `find_status`, which shares
+// no code with the vectorized scanner.
+status_counts count_lines(std::string_view data) {
+  status_counts counts;
+  while (!data.empty()) {
+    const std::size_t end = std::min(data.find('\n'), data.size());
+    const std::string_view line = data.substr(0, end);
+    data.remove_prefix(std::min(end + 1, data.size()));
+    if (line.empty()) {
+      continue;
+    }
+    const auto code = httpcode::find_status(line);
+    if (code.has_value()) {
+      ++counts.codes[*code];
+    } else {
+      ++counts.malformed;
+    }
+  }
+  return counts;
+}
+
+// The scanner works in 64-byte blocks with two bytes of lookahead and scans
+// what is left of the input one byte at a time. Every prefix of lines whose
+// status fields fall at every offset of a block must be counted as a line at
+// a time would.
+void test_scan_edges() {
+  std::string data;
+  for (std::size_t pad = 0; pad < 150; ++pad) {
+    data.append(pad, 'x');
+    switch (pad % 5) {
+      case 0:
+        data += " \"GET / HTTP/1.1\" 404 12\n";
+        break;
+      case 1:
+        // Only the second candidate is a status field.
+        data += " \"GET / HTTP/1.1\" 20 \"-\" \" 503 \"\n";
+        break;
+      case 2:
+        data += "\n";
+        break;
+      case 3:
+        data += " \"\" 1x \"GET /\" 502 0\n";
+        break;
+      case 4:
+        // Only the first status field of a line counts.
+        data += " \"x\" 301 \"y\" 302 7\n";
+        break;
+    }
+  }
+  for (std::size_t size = 0; size <= data.size(); ++size) {
+    const std::string_view prefix = std::string_view(data).substr(0, size);
+    status_counts counts;
+    httpcode::scan_log(prefix, counts);
+    if (!same_counts(counts, count_lines(prefix))) {
+      check(false, "scan of the first " + std::to_string(size) + " bytes");
+      return;
+    }
+  }
+}
+
+// Returns the histogram of `analysis` as `histogram` prints it.
+std::string render(const httpcode::log_analysis& analysis) {
+  const httpcode::registry names;
+  return httpcode::test::capture([&](httpcode::output_buffer& out) {
+    httpcode::append_histogram(
+        out, analysis.counts, names, &analysis.latencies,
+        analysis.top.has_value() ? &*analysis.top : nullptr);
+  });
+}
+
+httpcode::analysis_options full_options() {
+  httpcode::analysis_options options;
+  options.latency_field = -1;
+  options.top_by = httpcode::top_key::path;
+  options.top_k = 5;
+  return options;
+}
+
+// Every thread count and backend must print the same histogram, with the
+// exact counts.
+void test_threads(const char* path, const generated_log& log) {
+  const char* paths[] = {path};
+  auto options = full_options();
+  const auto reference = httpcode::analyze_logs(paths, options);
+  check(reference.has_value(), "analyze_logs with one thread");
+  if (!reference.has_value()) {
+    return;
+  }
+  check(same_counts(reference->counts, log.counts), "exact counts");
+  const std::string expected = render(*reference);
+
+  for (const unsigned int threads : {2u, 3u, 8u}) {
+    for (const auto io : {httpcode::io_backend::mmap,
+                          httpcode::io_backend::read,
+                          httpcode::io_backend::uring}) {
+      options.threads = threads;
+      options.io = io;
+      const auto analysis = httpcode::analyze_logs(paths, options);
+      check(analysis.has_value() && render(*analysis) == expected,
+            "histogram with -j " + std::to_string(threads) + " and --io " +
+                std::to_string(static_cast<int>(io)));
+    }
+  }
+}
+
+// Compressed logs must give what the plain log gives, alone and together.
+void test_compressed(const char* path, const generated_log& log) {
+  const auto gz = httpcode::test::temp_path("analysis_test.log.gz");
+  const auto zst = httpcode::test::temp_path("analysis_test.log.zst");
+  httpcode::test::write_gzip(gz, log.text);
+  httpcode::test::write_zstd(zst, log.text);
+  const std::string gz_name = gz.string();
+  const std::string zst_name = zst.string();
+
+  auto options = full_options();
+  options.threads = 4;
+  const char* plain_paths[] = {path};
+  const auto plain = httpcode::analyze_logs(plain_paths, options);
+  check(plain.has_value(), "analyze_logs of the plain log");
+  for (const char* compressed : {gz_name.c_str(), zst_name.c_str()}) {
+    const char* paths[] = {compressed};
+    const auto analysis = httpcode::analyze_logs(paths, options);
+    check(plain.has_value() && analysis.has_value() &&
+              render(*analysis) == render(*plain),
+          std::string("histogram of ") + compressed);
+  }
+
+  const char* all[] = {path, gz_name.c_str(), zst_name.c_str()};
+  const auto analysis = httpcode::analyze_logs(all, options);
+  check(analysis.has_value(), "analyze_logs of plain and compressed logs");
+  if (analysis.has_value()) {
+    bool tripled = analysis->counts.malformed == 3 * log.counts.malformed;
+    for (unsigned int code = 0; code < 1000; ++code) {
+      tripled &= analysis->counts.codes[code] == 3 * log.counts.codes[code];
+    }
+    check(tripled, "plain and compressed logs add up");
+  }
+  std::filesystem::remove(gz);
+  std::filesystem::remove(zst);
+}
+
+// `--only` keeps the counts, request times and top keys of the selected
+// codes, and those alone.
+void test_only(const char* path, const generated_log& log) {
+  const auto only = httpcode::parse_code_query("5xx,-503");
+  check(only.has_value(), "parse --only query");
+  if (!only.has_value()) {
+    return;
+  }
+  const char* paths[] = {path};
+  auto options = full_options();
+  options.threads = 3;
+  options.only = &*only;
+  auto analysis = httpcode::analyze_logs(paths, options);
+  check(analysis.has_value(), "analyze_logs with --only");
+  if (!analysis.has_value()) {
+    return;
+  }
+  analysis->keep_only(*only);
+
+  check(analysis->counts.malformed == 0, "--only drops malformed lines");
+  for (unsigned int code = 0; code < 1000; ++code) {
+    const bool selected = only->contains(code);
+    const auto& times = analysis->latencies.codes[code];
+    check(analysis->counts.codes[code] ==
+                  (selected ? log.counts.codes[code] : 0) &&
+              (times == nullptr
+                   ? !selected || log.latencies[code].empty()
+                   : selected && times->count() == log.latencies[code].size()),
+          "--only counts of code " + std::to_string(code));
+  }
+
+  // No sketch is full, so the top keys are exact.
+  std::vector<std::uint64_t> exact;
+  for (const auto& [key, count] : log.paths) {
+    if (key.first == 502) exact.push_back(count);
+  }
+  std::sort(exact.rbegin(), exact.rend());
+  exact.resize(std::min<std::size_t>(exact.size(), options.top_k));
+  std::vector<std::uint64_t> top;
+  for (const auto& entry : analysis->top->top(502)) {
+    check(entry.error == 0 &&
+              entry.count == log.paths.at({502, std::string(entry.key)}),
+          "exact top key " + std::string(entry.key));
+    top.push_back(entry.count);
+  }
+  check(top == exact, "top keys of 502");
+  check(analysis->top->top(404).empty(), "no top keys outside --only");
+}
+
+// Every quantile is the upper end of the bucket of the exact one, which is
+// at most 1/32 above it.
+void test_latency(const char* path, const generated_log& log) {
+  const char* paths[] = {path};
+  auto options = full_options();
+  options.threads = 2;
+  const auto analysis = httpcode::analyze_logs(paths, options);
+  check(analysis.has_value(), "analyze_logs with --latency");
+  if (!analysis.has_value()) {
+    return;
+  }
+  for (unsigned int code = 0; code < 1000; ++code) {
+    std::vector<std::uint64_t> times = log.latencies[code];
+    const auto& histogram = analysis->latencies.codes[code];
+    if (times.empty()) {
+      check(histogram == nullptr || histogram->count() == 0,
+            "no request times for code " + std::to_string(code));
+      continue;
+    }
+    if (histogram == nullptr || histogram->count() != times.size()) {
+      check(false, "request times of code " + std::to_string(code));
+      continue;
+    }
+    std::sort(times.begin(), times.end());
+    for (const double q : httpcode::latency_quantiles) {
+      const auto rank = std::max<std::size_t>(
+          static_cast<std::size_t>(
+              std::ceil(q * static_cast<double>(times.size()))),
+          1);
+      const std::uint64_t exact = times[rank - 1];
+      const std::uint64_t reported = histogram->quantile(q);
+      check(reported >= exact && reported <= exact + exact / 32,
+            "quantile " + std::to_string(q) + " of code " +
+                std::to_string(code) + ": " + std::to_string(reported) +
+                " for " + std::to_string(exact));
+    }
+  }
+}
+
+// Returns the snapshot of `analysis` as `histogram --snapshot` writes it.
+std::string snapshot(const httpcode::log_analysis& analysis) {
+  return httpcode::test::capture([&](httpcode::output_buffer& out) {
+    httpcode::append_snapshot(out, analysis, true);
+  });
+}
+
+// Reporting the merged snapshots of two halves of a log must print what the
+// histogram of the whole log prints.
+void test_snapshot(const char* path, const generated_log& log) {
+  const std::size_t middle = log.text.find('\n', log.text.size() / 2) + 1;
+  const auto first = httpcode::test::temp_path("analysis_test.1.log");
+  const auto second = httpcode::test::temp_path("analysis_test.2.log");
+  httpcode::test::write_file(first, log.text.substr(0, middle));
+  httpcode::test::write_file(second, log.text.substr(middle));
+  const std::string first_name = first.string();
+  const std::string second_name = second.string();
+
+  httpcode::analysis_options options;
+  options.threads = 2;
+  options.latency_field = -1;
+  const char* whole_paths[] = {path};
+  const char* first_paths[] = {first_name.c_str()};
+  const char* second_paths[] = {second_name.c_str()};
+  const auto whole = httpcode::analyze_logs(whole_paths, options);
+  const auto a = httpcode::analyze_logs(first_paths, options);
+  const auto b = httpcode::analyze_logs(second_paths, options);
+  check(whole.has_value() && a.has_value() && b.has_value(),
+        "analyze_logs of the halves");
+  if (whole.has_value() && a.has_value() && b.has_value()) {
+    // As `merge` and then `report` would.
+    httpcode::log_analysis merged;
+    const auto from_a = httpcode::add_snapshot(snapshot(*a), merged);
+    const auto from_b = httpcode::add_snapshot(snapshot(*b), merged);
+    check(from_a.has_value() && *from_a && from_b.has_value() && *from_b,
+          "add snapshots with request times");
+    httpcode::log_analysis reported;
+    check(httpcode::add_snapshot(snapshot(merged), reported).has_value(),
+          "add merged snapshot");
+    check(same_counts(reported.counts, log.counts),
+          "merged snapshots have the exact counts");
+    check(render(reported) == render(*whole),
+          "report of merged snapshots matches the histogram");
+  }
+  std::filesystem::remove(first);
+  std::filesystem::remove(second);
+}
+
+// A pipe has no size to map or read up to, and no offsets to sample, so it
+// must be refused rather than read as empty.
+void test_pipe() {
+  int fds[2];
+  if (::pipe(fds) != 0) {
+    check(false, "pipe");
+    return;
+  }
+  constexpr std::string_view line =
+      "10.0.0.1 - - [10/Oct/2000:13:55:36 -0700] \"GET / HTTP/1.1\" 200 1\n";
+  check(::write(fds[1], line.data(), line.size()) ==
+            static_cast<ssize_t>(line.size()),
+        "write to pipe");
+  const std::string path = "/proc/self/fd/" + std::to_string(fds[0]);
+  const char* paths[] = {path.c_str()};
+
+  for (const auto io : {httpcode::io_backend::mmap, httpcode::io_backend::read,
+                        httpcode::io_backend::uring}) {
+    httpcode::analysis_options options;
+    options.io = io;
+    check(fails_with(httpcode::analyze_logs(paths, options),
+                     "not a regular file"),
+          "pipe is refused with --io " + std::to_string(static_cast<int>(io)));
+  }
+  httpcode::sample_options sampling;
+  sampling.rate = 1;
+  check(
+      fails_with(httpcode::sample_logs(paths, sampling), "not a regular file"),
+      "pipe is refused by sampling");
+  // Nothing may have been consumed from the pipe.
+  char buffer[256];
+  check(::read(fds[0], buffer, sizeof(buffer)) ==
+            static_cast<ssize_t>(line.size()),
+        "pipe left unread");
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+}  // namespace
+
+int main() {
+  test_scan_edges();
+
+  // Large enough for several chunks per thread and several decompressed
+  // pieces.
+  const generated_log log = generate_log(60000, 7);
+  const auto path = httpcode::test::temp_path("analysis_test.log");
+  httpcode::test::write_file(path, log.text);
+  const std::string name = path.string();
+  test_threads(name.c_str(), log);
+  test_compressed(name.c_str(), log);
+  test_only(name.c_str(), log);
+  test_latency(name.c_str(), log);
+  test_snapshot(name.c_str(), log);
+  std::filesystem::remove(path);
+
+  test_pipe();
+  return httpcode::test::failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+// Checks `grep_logs` against a line-at-a-time reading of generated logs,
+// plain and compressed, with and without context.
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "code_set.hpp"
+#include "log_grep.hpp"
+#include "log_scan.hpp"
+#include "test_log.hpp"
+
+namespace {
+
+using httpcode::grep_options;
+using httpcode::test::check;
+
+struct log_file {
+  std::string path;
+  std::string text;
+};
+
+// Writes `lines` lines with the codes of a small site, and a rare 502, some
+// of them without a status field or empty. Without `newline`, the last line
+// is left unfinished.
+std::string generate_log(std::size_t lines, std::uint64_t seed,
+                         bool newline) {
+  static constexpr unsigned int codes[] = {200, 200, 200, 200, 200, 200,
+                                           301, 304, 404, 429, 500, 503};
+  std::mt19937_64 random(seed);
+  std::string text;
+  for (std::size_t i = 0; i < lines; ++i) {
+    if (random() % 300 == 0) {
+      text += random() % 2 == 0 ? "\n" : "truncated line\n";
+      continue;
+    }
+    text += "10.0.0." + std::to_string(random() % 256) +
+            " - - [10/Oct/2000:13:55:36 -0700] \"GET /p" +
+            std::to_string(random() % 1000) + " HTTP/1.1\" " +
+            std::to_string(random() % 2000 == 0
+                               ? 502
+                               : codes[random() % std::size(codes)]) +
+            " " + std::to_string(random() % 100000) + " \"-\" \"agent\"\n";
+  }
+  if (!newline && !text.empty()) {
+    text.pop_back();
+  }
+  return text;
+}
+
+// Selects and prints the lines of `files` one at a time, as grep(1) would.
+std::string expected_output(const std::vector<log_file>& files,
+                            const grep_options& options,
+                            std::uint64_t& selected) {
+  const bool prefix = files.size() > 1;
+  const bool context = options.before != 0 || options.after != 0;
+  std::string output;
+  bool printed_any = false;
+  selected = 0;
+  for (const log_file& file : files) {
+    std::vector<std::string_view> lines;
+    std::string_view text = file.text;
+    while (!text.empty()) {
+      const std::size_t end = std::min(text.find('\n'), text.size());
+      lines.push_back(text.substr(0, end));
+      text.remove_prefix(std::min(end + 1, text.size()));
+    }
+
+    std::vector<bool> matched(lines.size());
+    std::vector<bool> shown(lines.size());
+    std::uint64_t file_selected = 0;
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+      const auto code = httpcode::find_status(lines[i]);
+      matched[i] =
+          (code.has_value() && options.codes.contains(*code)) != options.invert;
+      if (matched[i]) {
+        ++file_selected;
+        const std::size_t first = i - std::min(i, options.before);
+        const std::size_t last =
+            std::min(i + options.after, lines.size() - 1);
+        std::fill(shown.begin() + first, shown.begin() + last + 1, true);
+      }
+    }
+    selected += file_selected;
+    if (options.count) {
+      output += (prefix ? file.path + ":" : "") +
+                std::to_string(file_selected) + "\n";
+      continue;
+    }
+
+    bool adjacent = false;
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+      if (!shown[i]) {
+        adjacent = false;
+        continue;
+      }
+      if (context && printed_any && !adjacent) {
+        output += "--\n";
+      }
+      if (prefix) {
+        output += file.path + (matched[i] ? ":" : "-");
+      }
+      output += lines[i];
+      output += '\n';
+      printed_any = true;
+      adjacent = true;
+    }
+  }
+  return output;
+}
+
+void check_grep(const std::vector<log_file>& files, const char* query,
+                const grep_options& base, const std::string& what) {
+  grep_options options = base;
+  options.codes = *httpcode::parse_code_query(query);
+  std::vector<const char*> paths;
+  for (const log_file& file : files) paths.push_back(file.path.c_str());
+
+  std::uint64_t expected_selected = 0;
+  const std::string expected =
+      expected_output(files, options, expected_selected);
+  tl::expected<std::uint64_t, std::runtime_error> selected = 0;
+  const std::string output = httpcode::test::capture(
+      [&](int fd) { selected = httpcode::grep_logs(paths, options, fd); });
+  check(selected.has_value() && *selected == expected_selected,
+        what + ": number of selected lines");
+  check(output == expected, what + ": output");
+}
+
+}  // namespace
+
+int main() {
+  // Several decompressed pieces, so that context crosses their boundaries.
+  const std::string text = generate_log(40000, 11, true);
+  const log_file plain{httpcode::test::temp_path("grep_test.log").string(),
+                       text};
+  const log_file gz{httpcode::test::temp_path("grep_test.log.gz").string(),
+                    text};
+  const log_file zst{httpcode::test::temp_path("grep_test.log.zst").string(),
+                     text};
+  const log_file unfinished{
+      httpcode::test::temp_path("grep_test.short.log").string(),
+      generate_log(500, 12, false)};
+  httpcode::test::write_file(plain.path, plain.text);
+  httpcode::test::write_gzip(gz.path, gz.text);
+  httpcode::test::write_zstd(zst.path, zst.text);
+  httpcode::test::write_file(unfinished.path, unfinished.text);
+
+  grep_options lines;
+  grep_options invert;
+  invert.invert = true;
+  grep_options count;
+  count.count = true;
+  grep_options around;
+  around.before = 2;
+  around.after = 2;
+  grep_options uneven;
+  uneven.before = 3;
+  uneven.after = 1;
+  grep_options wide;
+  wide.before = 40;
+  wide.after = 40;
+
+  for (const log_file& file : {plain, gz, zst}) {
+    const std::vector<log_file> files = {file};
+    check_grep(files, "5xx", lines, file.path + " 5xx");
+    check_grep(files, "2xx", invert, file.path + " -v 2xx");
+    check_grep(files, "404,429", around, file.path + " -C 2 404,429");
+    check_grep(files, "502", wide, file.path + " -C 40 502");
+  }
+  const std::vector<log_file> several = {plain, unfinished, zst};
+  check_grep(several, "4xx", count, "-c 4xx over several files");
+  check_grep(several, "500", lines, "500 over several files");
+  check_grep(several, "3xx,-304", uneven,
+             "-B 3 -A 1 3xx,-304 over several files");
+  check_grep({unfinished}, "2xx", invert, "-v 2xx of an unfinished line");
+  check_grep({unfinished}, "200", around, "-C 2 200 of an unfinished line");
+
+  for (const log_file& file : {plain, gz, zst, unfinished}) {
+    std::filesystem::remove(file.path);
+  }
+  return httpcode::test::failures == 0 ? 0 : 1;
+}
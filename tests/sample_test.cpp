@@ -0,0 +1,169 @@
+// Checks the estimates of `sample_logs` against the exact counts of
+// `analyze_logs` on a generated log: a full sample must reproduce them with
+// no margin, and the 95% intervals of partial samples must cover them about
+// as often as they claim to.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include "log_analysis.hpp"
+#include "log_sample.hpp"
+#include "test_log.hpp"
+
+namespace {
+
+using httpcode::sample_estimate;
+using httpcode::test::check;
+
+// Writes a log whose errors come in bursts, as they do in practice, so that
+// lines in the same block are far from independent.
+void write_log(const std::filesystem::path& path) {
+  std::mt19937_64 random(42);
+  std::ofstream out(path);
+  unsigned int burst_code = 0;
+  int burst_left = 0;
+  for (int i = 0; i < 80000; ++i) {
+    if (burst_left == 0 && random() % 400 == 0) {
+      static constexpr unsigned int burst_codes[] = {500, 502, 503, 429};
+      burst_code = burst_codes[random() % std::size(burst_codes)];
+      burst_left = static_cast<int>(20 + random() % 200);
+    }
+    if (random() % 1000 == 0) {
+      out << "truncated line " << i << '\n';
+      continue;
+    }
+    unsigned int code = 200;
+    if (burst_left > 0 && random() % 3 != 0) {
+      code = burst_code;
+    } else if (random() % 20 == 0) {
+      code = 404;
+    } else if (random() % 50 == 0) {
+      code = 301;
+    }
+    burst_left = std::max(burst_left - 1, 0);
+    out << "10.0." << random() % 256 << '.' << random() % 256
+        << " - - [10/Oct/2000:13:55:36 -0700] \"GET /p" << random() % 1000
+        << " HTTP/1.1\" " << code << ' ' << random() % 10000 << '\n';
+  }
+}
+
+// Returns whether `v` has a margin that covers `exact`.
+bool covers(const sample_estimate::value& v, std::uint64_t exact) {
+  return v.count_margin >= 0 &&
+         std::abs(v.count - static_cast<double>(exact)) <= v.count_margin;
+}
+
+}  // namespace
+
+int main() {
+  const auto path = httpcode::test::temp_path("sample_test");
+  write_log(path);
+  const std::string name = path.string();
+  const char* paths[] = {name.c_str()};
+
+  httpcode::analysis_options analysis;
+  analysis.threads = 2;
+  const auto exact = httpcode::analyze_logs(paths, analysis);
+  check(exact.has_value(), "analyze_logs");
+  if (!exact.has_value()) {
+    std::filesystem::remove(path);
+    return 1;
+  }
+  const httpcode::status_counts& counts = exact->counts;
+  std::uint64_t category_counts[std::size(httpcode::categories)] = {};
+  for (std::size_t c = 0; c < std::size(httpcode::categories); ++c) {
+    for (unsigned int code = httpcode::categories[c].first_code;
+         code <= httpcode::categories[c].last_code; ++code) {
+      category_counts[c] += counts.codes[code];
+    }
+  }
+
+  httpcode::sample_options options;
+  options.threads = 2;
+  options.block_size = 4 << 10;
+
+  // A full sample is the exact histogram.
+  options.rate = 1;
+  const auto full = httpcode::sample_logs(paths, options);
+  check(full.has_value(), "sample_logs at rate 1");
+  if (full.has_value()) {
+    check(full->blocks == full->total_blocks, "all blocks sampled");
+    check(full->bytes_read == full->total_bytes, "all bytes sampled");
+    for (unsigned int code = 0; code < counts.codes.size(); ++code) {
+      const sample_estimate::value v = full->code(code);
+      check(std::llround(v.count) ==
+                    static_cast<long long>(counts.codes[code]) &&
+                v.count_margin == 0 && v.share_margin == 0,
+            "full sample of code " + std::to_string(code));
+    }
+    for (std::size_t c = 0; c < std::size(httpcode::categories); ++c) {
+      const sample_estimate::value v = full->category(c);
+      check(std::llround(v.count) ==
+                    static_cast<long long>(category_counts[c]) &&
+                v.count_margin == 0,
+            "full sample of category " + std::to_string(c));
+    }
+    check(std::llround(full->malformed().count) ==
+              static_cast<long long>(counts.malformed),
+          "full sample of malformed lines");
+  }
+
+  // A log of a single block is read whole at any rate, so it has exact
+  // counts even though one block gives no variance to go by.
+  options.rate = 0.5;
+  options.block_size = std::filesystem::file_size(path);
+  const auto single = httpcode::sample_logs(paths, options);
+  check(single.has_value(), "sample_logs of a single block");
+  if (single.has_value()) {
+    check(single->blocks == 1 && single->total_blocks == 1,
+          "single block sampled");
+    const sample_estimate::value v = single->code(200);
+    check(std::llround(v.count) == static_cast<long long>(counts.codes[200]) &&
+              v.count_margin == 0 && v.share_margin == 0,
+          "single block has exact counts");
+  }
+  options.block_size = 4 << 10;
+
+  // Partial samples: over a fixed set of seeds, the intervals must cover the
+  // exact counts close to 95% of the time. The normal approximation is a
+  // little optimistic for the few blocks of a 2% sample, hence the slack.
+  for (const double rate : {0.02, 0.1, 0.4}) {
+    options.rate = rate;
+    int estimates = 0;
+    int covered = 0;
+    for (std::uint64_t seed = 1; seed <= 50; ++seed) {
+      options.seed = seed;
+      const auto sample = httpcode::sample_logs(paths, options);
+      check(sample.has_value(),
+            "sample_logs at rate " + std::to_string(rate));
+      if (!sample.has_value()) {
+        continue;
+      }
+      for (std::size_t c = 0; c < std::size(httpcode::categories); ++c) {
+        if (category_counts[c] != 0) {
+          ++estimates;
+          covered += covers(sample->category(c), category_counts[c]);
+        }
+      }
+      for (const unsigned int code : {200u, 404u, 502u}) {
+        ++estimates;
+        covered += covers(sample->code(code), counts.codes[code]);
+      }
+    }
+    const double coverage = static_cast<double>(covered) / estimates;
+    std::printf("rate %.2f: %d of %d intervals cover the exact count\n", rate,
+                covered, estimates);
+    check(coverage >= 0.8,
+          "coverage at rate " + std::to_string(rate) + " is " +
+              std::to_string(coverage));
+  }
+
+  std::filesystem::remove(path);
+  return httpcode::test::failures == 0 ? 0 : 1;
+}
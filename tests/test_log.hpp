@@ -0,0 +1,96 @@
+#ifndef HTTPCODE_TEST_LOG_HPP_
+#define HTTPCODE_TEST_LOG_HPP_
+
+#include <unistd.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "output_buffer.hpp"
+
+namespace httpcode::test {
+
+/// Test helpers
+//
+// Shared by the tests: failure reporting, temporary files and the gzip and
+// zstd copies of generated logs.
+
+inline int failures = 0;
+
+inline void check(bool ok, const std::string& what) {
+  if (!ok) {
+    std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+// Returns a path in the temporary directory that no other process uses.
+inline std::filesystem::path temp_path(std::string_view name) {
+  return std::filesystem::temp_directory_path() /
+         ("httpcode_" + std::string(name) + "." + std::to_string(::getpid()));
+}
+
+inline void write_file(const std::filesystem::path& path,
+                       std::string_view data) {
+  std::ofstream(path, std::ios::binary).write(data.data(), data.size());
+}
+
+inline std::string read_file(const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), {}};
+}
+
+inline void write_gzip(const std::filesystem::path& path,
+                       std::string_view data) {
+  gzFile file = gzopen(path.c_str(), "wb");
+  const auto size = static_cast<unsigned int>(data.size());
+  check(file != nullptr &&
+            gzwrite(file, data.data(), size) == static_cast<int>(size) &&
+            gzclose(file) == Z_OK,
+        "write " + path.string());
+}
+
+inline void write_zstd(const std::filesystem::path& path,
+                       std::string_view data) {
+  std::string compressed(ZSTD_compressBound(data.size()), '\0');
+  const std::size_t size = ZSTD_compress(compressed.data(), compressed.size(),
+                                         data.data(), data.size(), 3);
+  check(!ZSTD_isError(size), "compress " + path.string());
+  compressed.resize(ZSTD_isError(size) ? 0 : size);
+  write_file(path, compressed);
+}
+
+// Returns what `fn` writes to the output buffer or file descriptor it is
+// given.
+template <typename Fn>
+std::string capture(Fn&& fn) {
+  std::FILE* file = std::tmpfile();
+  if (file == nullptr) {
+    check(false, "tmpfile");
+    return {};
+  }
+  const int fd = ::fileno(file);
+  if constexpr (std::is_invocable_v<Fn, output_buffer&>) {
+    output_buffer out(fd);
+    fn(out);
+  } else {
+    fn(fd);
+  }
+  std::string text(static_cast<std::size_t>(::lseek(fd, 0, SEEK_END)), '\0');
+  check(::pread(fd, text.data(), text.size(), 0) ==
+            static_cast<ssize_t>(text.size()),
+        "read captured output");
+  std::fclose(file);
+  return text;
+}
+
+}  // namespace httpcode::test
+
+#endif  // HTTPCODE_TEST_LOG_HPP_